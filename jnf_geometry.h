@@ -2,12 +2,29 @@
 #define JNF_GEOMETRY_H
 
 #include <cmath>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <numbers>
+#include <optional>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <algorithm>
 
+#ifdef JNF_GEOMETRY_INSTRUMENT
+#include "jnf_geometry_instrument.h"
+#else
+#define JNF_GEOMETRY_PROBE(o, a, b) ((void) 0)
+#define JNF_GEOMETRY_RESULT(x) (x)
+#define JNF_GEOMETRY_HIT(x) ((void) 0)
+#define JNF_GEOMETRY_REJECT() ((void) 0)
+#endif
+
 namespace jnf {
     constexpr double eps = 1e-3;
 
@@ -43,7 +60,7 @@ namespace jnf {
 
         inline vec2 norm() const {
             auto r = 1 / mag();
-            return v_2d(x * r, y * r);
+            return vec2(x * r, y * r);
         }
 
         inline constexpr vec2 perp() const {
@@ -98,12 +115,70 @@ namespace jnf {
             return x != v.x || y != v.y;
         }
 
+        inline constexpr vec2 operator+(const vec2& v) const {
+            return vec2(x + v.x, y + v.y);
+        }
+
         inline constexpr vec2 operator-(const vec2& v) const {
             return vec2(x - v.x, y - v.y);
         }
+
+        inline constexpr vec2 operator-() const {
+            return vec2(-x, -y);
+        }
+
+        inline constexpr vec2 operator*(const T& s) const {
+            return vec2(x * s, y * s);
+        }
+
+        inline constexpr vec2 operator/(const T& s) const {
+            return vec2(x / s, y / s);
+        }
+
+        friend inline constexpr vec2 operator*(const T& s, const vec2& v) {
+            return vec2(s * v.x, s * v.y);
+        }
     };
 
     namespace geometry {
+        // Container returned by intersects. Every intersects overload takes an
+        // optional trailing allocator, so results can be routed into an
+        // arena, e.g. a std::pmr::monotonic_buffer_resource reset per frame
+        // through pmr::points. Alternatively intersects(a, b, f) hands each
+        // point to f instead; f may return false to stop early, which is then
+        // reported by the overload returning false.
+        template <typename T, typename A = std::allocator<vec2<T>>>
+        using points = std::vector<vec2<T>, A>;
+
+        namespace pmr {
+            template <typename T>
+            using points = geometry::points<T,
+                    std::pmr::polymorphic_allocator<vec2<T>>>;
+        }
+
+        namespace detail {
+            template <typename A>
+            concept allocator = requires(A a, std::size_t n) {
+                typename A::value_type;
+                a.deallocate(a.allocate(n), n);
+            };
+
+            template <typename F, typename P>
+            concept visitor = std::invocable<F&, const P&>;
+
+            // Calls a visitor that either returns nothing or whether to go on.
+            template <typename F, typename T>
+            inline bool visit(F& f, const vec2<T>& p) {
+                if constexpr (std::is_void_v<
+                        std::invoke_result_t<F&, const vec2<T>&>>) {
+                    f(p);
+                    return true;
+                } else {
+                    return static_cast<bool>(f(p));
+                }
+            }
+        }
+
         template <typename T>
         struct line {
             vec2<T> start;
@@ -117,11 +192,11 @@ namespace jnf {
                 return end - start;
             }
 
-            inline constexpr T length() {
+            inline constexpr T length() const {
                 return vec().mag();
             }
 
-            inline constexpr T length2() {
+            inline constexpr T length2() const {
                 return vec().mag2();
             }
 
@@ -148,19 +223,19 @@ namespace jnf {
             }
 
             inline line<T> top() const {
-                return {pos, {pos.x + size.x, pos.y}};
+                return line<T>(pos, {pos.x + size.x, pos.y});
             }
 
             inline line<T> bottom() const {
-                return {{pos.x, pos.y + size.y}, pos + size};
+                return line<T>({pos.x, pos.y + size.y}, pos + size);
             }
 
             inline line<T> left() const {
-                return {pos, {pos.x, pos.y + size.y}};
+                return line<T>(pos, {pos.x, pos.y + size.y});
             }
 
             inline line<T> right() const {
-                return {{pos.x + size.x, pos.y}, pos + size};
+                return line<T>({pos.x + size.x, pos.y}, pos + size);
             }
 
             inline line<T> side(const int32_t i) const {
@@ -174,7 +249,7 @@ namespace jnf {
                     case 3:
                         return left();
                     default:
-                        return {};
+                        return line<T>();
                 }
             }
 
@@ -209,25 +284,68 @@ namespace jnf {
             }
         };
 
+        namespace detail {
+            // Closed box test used for pruning by the spatial indices, so
+            // that a box touching the query only along an edge, or a zero
+            // size box or query on one, is still reached. overlaps(rect,
+            // rect) is half-open and would drop those.
+            template <typename T1, typename T2>
+            inline constexpr bool meets(const rect<T1>& a,
+                    const rect<T2>& b) {
+                return a.pos.x <= b.pos.x + b.size.x
+                        && b.pos.x <= a.pos.x + a.size.x
+                        && a.pos.y <= b.pos.y + b.size.y
+                        && b.pos.y <= a.pos.y + a.size.y;
+            }
+
+            // Whether the rect stays clear of the band around the circle in
+            // which intersects(circle, line) accepts points (eps on squared
+            // distance for tangents, eps on distance otherwise), outside the
+            // circle or inside it, so that no side of it is hit.
+            template <typename T1, typename T2>
+            inline bool clear_of(const circle<T1>& c, const rect<T2>& r) {
+                const auto lo = r.pos - vec2<T2>(c.center.x, c.center.y);
+                const auto hi = lo + r.size;
+                const double nearest = vec2<T2>(
+                        std::clamp(T2(0), lo.x, hi.x),
+                        std::clamp(T2(0), lo.y, hi.y)).mag2();
+                const double farthest = vec2<T2>(std::max(-lo.x, hi.x),
+                        std::max(-lo.y, hi.y)).mag2();
+                const double radius = c.radius;
+                const auto outer = std::max(radius * radius + eps,
+                        (radius + eps) * (radius + eps));
+                const auto inner = std::min(radius * radius - eps,
+                        (radius - eps) * (radius - eps));
+                return nearest >= outer || (radius > eps && farthest <= inner);
+            }
+        }
+
         template<typename T1, typename T2>
         inline vec2<T1> closest(const vec2<T1>& p1, const vec2<T2>& p2) {
+            JNF_GEOMETRY_PROBE(closest, p1, p2);
             return p1;
         }
 
         template<typename T1, typename T2>
         inline vec2<T1> closest(const line<T1>& l, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(closest, l, p);
             auto d = l.vec();
+            if (l.length2() == 0) {
+                return l.start;
+            }
             return l.start + std::clamp(static_cast<double>(d.dot(p - l.start))
                     / l.length2(), 0.0, 1.0) * d;
         }
 
         template<typename T1, typename T2>
         inline vec2<T1> closest(const circle<T1>& c, const vec2<T2>& p) {
-            return c.pos + vec2(p - c.pos).norm() * c.radius;
+            JNF_GEOMETRY_PROBE(closest, c, p);
+            return c.center + vec2(p - c.center).norm() * c.radius;
         }
 
         template<typename T1, typename T2>
         inline vec2<T1> closest(const rect<T1>& r, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(closest, r, p);
             auto c_min = closest(r.top(), p);
             auto d_min = (c_min - p).mag2();
             for (auto i = 1; i < 4; ++i) {
@@ -243,352 +361,663 @@ namespace jnf {
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const vec2<T1>& p1, const vec2<T2>& p2) {
-            return (p1 - p2).mag2() < eps;
+            JNF_GEOMETRY_PROBE(contains, p1, p2);
+            return JNF_GEOMETRY_RESULT((p1 - p2).mag2() < eps);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const line<T1>& l, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(contains, l, p);
             const double d = (p.x - l.start.x) * (l.end.y - l.start.y)
                     - (p.y - l.start.y) * (l.end.x - l.start.x);
             if (std::abs(d) < eps) {
                 const double u = l.vec().dot(p - l.start) / l.length2();
-                return u >= 0.0 && u <= 1.0;
+                return JNF_GEOMETRY_RESULT(u >= 0.0 && u <= 1.0);
             }
-            return false;
+            return JNF_GEOMETRY_RESULT(false);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const rect<T1>& r, const vec2<T2>& p) {
-            return p.x >= r.pos.x
+            JNF_GEOMETRY_PROBE(contains, r, p);
+            return JNF_GEOMETRY_RESULT(p.x >= r.pos.x
                     && p.y >= r.pos.y
                     && p.x <= r.pos.x + r.size.x
-                    && p.y <= r.pos.y + r.size.y;
+                    && p.y <= r.pos.y + r.size.y);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const circle<T1>& c, const vec2<T2>& p) {
-            return (c.pos - p).mag2() < (c.radius * c.radius);
+            JNF_GEOMETRY_PROBE(contains, c, p);
+            return JNF_GEOMETRY_RESULT(
+                    (c.center - p).mag2() < (c.radius * c.radius));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const vec2<T1>& p1, const vec2<T2>& p2) {
-            return contains(p1, p2);
+            JNF_GEOMETRY_PROBE(overlaps, p1, p2);
+            return JNF_GEOMETRY_RESULT(contains(p1, p2));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const line<T1>& l, const vec2<T2>& p) {
-            return contains(l, p);
+            JNF_GEOMETRY_PROBE(overlaps, l, p);
+            return JNF_GEOMETRY_RESULT(contains(l, p));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const rect<T1>& r, const vec2<T2>& p) {
-            return contains(r, p);
+            JNF_GEOMETRY_PROBE(overlaps, r, p);
+            return JNF_GEOMETRY_RESULT(contains(r, p));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const circle<T1>& c, const vec2<T2>& p) {
-            return contains(c, p);
+            JNF_GEOMETRY_PROBE(overlaps, c, p);
+            return JNF_GEOMETRY_RESULT(contains(c, p));
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const vec2<T1>& p1,
-                const vec2<T2>& p2) {
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const vec2<T1>& p1, const vec2<T2>& p2,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, p1, p2);
             if (contains(p1, p2)) {
-                return {p1};
+                JNF_GEOMETRY_HIT(true);
+                return detail::visit(f, p1);
             }
-            return {};
+            return true;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const line<T1>& l,
-                const vec2<T2>& p) {
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const vec2<T1>& p1,
+                const vec2<T2>& p2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(p1, p2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const line<T1>& l, const vec2<T2>& p,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, l, p);
             if (contains(l, p)) {
-                return {p};
+                JNF_GEOMETRY_HIT(true);
+                return detail::visit(f, p);
             }
-            return {};
+            return true;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const rect<T1>& r,
-                const vec2<T2>& p) {
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const line<T1>& l,
+                const vec2<T2>& p, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(l, p, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const rect<T1>& r, const vec2<T2>& p,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, r, p);
             if (contains(r.top(), p) || contains(r.bottom(), p)
                     || contains(r.left(), p) || contains(r.right(), p)) {
-                return {p};
+                JNF_GEOMETRY_HIT(true);
+                return detail::visit(f, p);
             }
-            return {};
+            return true;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const circle<T1>& c,
-                const vec2<T2>& p) {
-            if (std::abs((p - c.pos).mag2() - c.radius * c.radius) < eps) {
-                return {p};
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const rect<T1>& r,
+                const vec2<T2>& p, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(r, p, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const circle<T1>& c, const vec2<T2>& p,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c, p);
+            if (std::abs((p - c.center).mag2() - c.radius * c.radius) < eps) {
+                JNF_GEOMETRY_HIT(true);
+                return detail::visit(f, p);
             }
-            return {};
+            return true;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const circle<T1>& c,
+                const vec2<T2>& p, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c, p, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const vec2<T1>& p, const line<T2>& l) {
-            return false;
+            JNF_GEOMETRY_PROBE(contains, p, l);
+            return JNF_GEOMETRY_RESULT(false);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const line<T1>& l1, const line<T2>& l2) {
-            return overlaps(l1, l2.start) && overlaps(l1, l2.end);
+            JNF_GEOMETRY_PROBE(contains, l1, l2);
+            return JNF_GEOMETRY_RESULT(
+                    overlaps(l1, l2.start) && overlaps(l1, l2.end));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const rect<T1>& r, const line<T2>& l) {
-            return contains(r, l.start) && contains(r, l.end);
+            JNF_GEOMETRY_PROBE(contains, r, l);
+            return JNF_GEOMETRY_RESULT(
+                    contains(r, l.start) && contains(r, l.end));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const circle<T1>& c, const line<T2>& l) {
-            return contains(c, l.start) && contains(c, l.end);
+            JNF_GEOMETRY_PROBE(contains, c, l);
+            return JNF_GEOMETRY_RESULT(
+                    contains(c, l.start) && contains(c, l.end));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const vec2<T1>& p, const line<T2>& l) {
-            return contains(l, p);
+            JNF_GEOMETRY_PROBE(overlaps, p, l);
+            return JNF_GEOMETRY_RESULT(contains(l, p));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const line<T1>& l1, const line<T2>& l2) {
-            const auto d = l2.vec().cross(l1.vec());
+            JNF_GEOMETRY_PROBE(overlaps, l1, l2);
+            const auto d = l1.vec().cross(l2.vec());
             const float u1 = l2.vec().cross(l1.start - l2.start) / d;
             const float u2 = l1.vec().cross(l1.start - l2.start) / d;
-            return u1 >= 0 && u1 <= 1 && u2 >= 0 && u2 <= 1;
+            return JNF_GEOMETRY_RESULT(
+                    u1 >= 0 && u1 <= 1 && u2 >= 0 && u2 <= 1);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const rect<T1>& r, const line<T2>& l) {
-            return overlaps(r.top(), l) || overlaps(r.bottom(), l)
-                    || overlaps(r.left(), l) || overlaps(r.right(), l);
+            JNF_GEOMETRY_PROBE(overlaps, r, l);
+            if (!detail::meets(r, envelope_r(l))) {
+                JNF_GEOMETRY_REJECT();
+                return JNF_GEOMETRY_RESULT(false);
+            }
+            return JNF_GEOMETRY_RESULT(
+                    overlaps(r.top(), l) || overlaps(r.bottom(), l)
+                    || overlaps(r.left(), l) || overlaps(r.right(), l));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const circle<T1>& c, const line<T2>& l) {
-            auto closest = closest(l, c.pos);
-            return (c.pos - closest).mag2() < c.radius * c.radius;
-        }
-
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const vec2<T1>& p,
-                const line<T2>& l) {
-            return intersects(l, p);
+            JNF_GEOMETRY_PROBE(overlaps, c, l);
+            auto p = closest(l, c.center);
+            return JNF_GEOMETRY_RESULT(
+                    (c.center - p).mag2() < c.radius * c.radius);
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const vec2<T1>& p, const line<T2>& l,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, p, l);
+            return intersects(l, p, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const vec2<T1>& p,
+                const line<T2>& l, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(p, l, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const line<T1>& l1,
-                const line<T2>& l2) {
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const line<T1>& l1, const line<T2>& l2,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, l1, l2);
             float rd = l1.vec().cross(l2.vec());
             if (rd == 0) {
-                return {};
+                JNF_GEOMETRY_REJECT();
+                return true;
             }
 
             rd = 1.f / rd;
 
-            const float rn = ((l2.end.x - l2.start.x) * (l1.start.y - l2.start.y)
+            const float rn = ((l2.end.x - l2.start.x)
+                * (l1.start.y - l2.start.y)
                 - (l2.end.y - l2.start.y) * (l1.start.x - l2.start.x)) * rd;
-            const float sn = ((l1.end.x - l1.start.x) * (l1.start.y - l2.start.y)
-                - (l1.end.y - l2.start.y) * (l1.start.x - l2.start.x)) * rd;
+            const float sn = ((l1.end.x - l1.start.x)
+                * (l1.start.y - l2.start.y)
+                - (l1.end.y - l1.start.y) * (l1.start.x - l2.start.x)) * rd;
 
             if (rn < 0.f || rn > 1.f || sn < 0.f || sn > 1.f) {
-                return {};
+                return true;
             }
-            return {l1.start + rn * l1.vec()};
+            JNF_GEOMETRY_HIT(true);
+            return detail::visit(f, l1.start + rn * l1.vec());
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const line<T1>& l1,
+                const line<T2>& l2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(l1, l2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const rect<T1>& r,
-                const line<T2>& l) {
-            std::vector<vec2<T2>> ret;
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const rect<T1>& r, const line<T2>& l,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, r, l);
+            if (!detail::meets(r, envelope_r(l))) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
             for (auto i = 0; i < 4; ++i) {
-                auto intersects = intersects(r.side(i), l);
-                if (!intersects.empty()) {
-                    ret.push_back(intersects[0]);
+                const bool more = intersects(r.side(i), l,
+                        [&f, &hit](const vec2<T2>& p) {
+                    hit = true;
+                    return detail::visit(f, p);
+                });
+                if (!more) {
+                    JNF_GEOMETRY_HIT(true);
+                    return false;
                 }
             }
+            JNF_GEOMETRY_HIT(hit);
+            return true;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const rect<T1>& r,
+                const line<T2>& l, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(r, l, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
             return ret;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const circle<T1>& c,
-                const line<T2>& l) {
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const circle<T1>& c, const line<T2>& l,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c, l);
             const auto d = l.vec();
-            const auto u = d.dot(c.pos - l.start) / d.mag2();
-            const auto closest = l.start + u * d;
+            const auto u = d.dot(c.center - l.start) / d.mag2();
+            const auto q = l.start + u * d;
 
-            const auto dist = (c.pos - closest).mag2();
+            const auto dist = (c.center - q).mag2();
             const auto r2 = c.radius * c.radius;
             if (std::abs(dist - r2) < eps) {
-                return {closest};
+                const bool hit = u >= 0 && u <= 1;
+                JNF_GEOMETRY_HIT(hit);
+                return !hit || detail::visit(f, q);
             }
             if (dist > r2) {
-                return {};
+                JNF_GEOMETRY_REJECT();
+                return true;
             }
 
             const auto length = std::sqrt(c.radius * c.radius - dist);
-            const auto p1 = closest + l.vec().norm() * length;
-            const auto p2 = closest - l.vec().norm() * length;
-            std::vector<vec2<T2>> ret;
-            if ((p1 - closest(l, p1)).mag2() < eps * eps) {
-                ret.push_back(p1);
-            }
-            if ((p2 - closest(l, p2)).mag2() < eps * eps) {
-                ret.push_back(p2);
+            const auto p1 = q + l.vec().norm() * length;
+            const auto p2 = q - l.vec().norm() * length;
+            const bool hit1 = (p1 - closest(l, p1)).mag2() < eps * eps;
+            const bool hit2 = (p2 - closest(l, p2)).mag2() < eps * eps;
+            JNF_GEOMETRY_HIT(hit1 || hit2);
+            if (hit1 && !detail::visit(f, p1)) {
+                return false;
             }
+            return !hit2 || detail::visit(f, p2);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const circle<T1>& c,
+                const line<T2>& l, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c, l, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
             return ret;
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const vec2<T1>& p, const rect<T2>& r) {
-            return false;
+            JNF_GEOMETRY_PROBE(contains, p, r);
+            return JNF_GEOMETRY_RESULT(false);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const line<T1>& l, const rect<T2>& r) {
-            return false;
+            JNF_GEOMETRY_PROBE(contains, l, r);
+            return JNF_GEOMETRY_RESULT(false);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const rect<T1>& r1, const rect<T2>& r2) {
-            return r2.pos.x >= r1.pos.x
+            JNF_GEOMETRY_PROBE(contains, r1, r2);
+            return JNF_GEOMETRY_RESULT(r2.pos.x >= r1.pos.x
                     && r2.pos.y >= r1.pos.y
                     && r2.pos.x + r2.size.x < r1.pos.x + r1.size.x
-                    && r2.pos.y + r2.size.y < r1.pos.y + r1.size.y;
+                    && r2.pos.y + r2.size.y < r1.pos.y + r1.size.y);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const circle<T1>& c, const rect<T2>& r) {
-            return contains(c, r.pos)
+            JNF_GEOMETRY_PROBE(contains, c, r);
+            return JNF_GEOMETRY_RESULT(contains(c, r.pos)
                     && contains(c, vec2<T2>(r.pos.x + r.size.x, r.pos.y))
                     && contains(c, vec2<T2>(r.pos.x, r.pos.y + r.size.y))
-                    && contains(c, r.pos + r.size);
+                    && contains(c, r.pos + r.size));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const vec2<T1>& p, const rect<T2>& r) {
-            return overlaps(r, p);
+            JNF_GEOMETRY_PROBE(overlaps, p, r);
+            return JNF_GEOMETRY_RESULT(overlaps(r, p));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const line<T1>& l, const rect<T2>& r) {
-            return overlaps(r, l);
+            JNF_GEOMETRY_PROBE(overlaps, l, r);
+            return JNF_GEOMETRY_RESULT(overlaps(r, l));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const rect<T1>& r1, const rect<T2>& r2) {
-            return r1.pos.x < r2.pos.x + r2.size.x
+            JNF_GEOMETRY_PROBE(overlaps, r1, r2);
+            return JNF_GEOMETRY_RESULT(r1.pos.x < r2.pos.x + r2.size.x
                     && r1.pos.x + r1.size.x >= r2.pos.x
                     && r1.pos.y < r2.pos.y + r2.size.y
-                    && r1.pos.y + r1.size.y >= r2.pos.y;
+                    && r1.pos.y + r1.size.y >= r2.pos.y);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const circle<T1>& c, const rect<T2>& r) {
-            T2 o = (vec2<T2>(std::clamp(c.pos.x, r.pos.x, r.pos.x + r.size.x),
-                    std::clamp(c.pos.y, r.pos.y, r.pos.y + r.size.y)) - c.pos)
-                    .mag2();
+            JNF_GEOMETRY_PROBE(overlaps, c, r);
+            T2 o = (vec2<T2>(
+                    std::clamp(c.center.x, r.pos.x, r.pos.x + r.size.x),
+                    std::clamp(c.center.y, r.pos.y, r.pos.y + r.size.y))
+                    - c.center).mag2();
             if (std::isnan(o)) {
                 o = T2(0);
             }
-            return o - (c.radius * c.radius) < T2(0);
+            return JNF_GEOMETRY_RESULT(o - (c.radius * c.radius) < T2(0));
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const vec2<T1>& p,
-                const rect<T2>& r) {
-            return intersects(r, p);
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const vec2<T1>& p, const rect<T2>& r,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, p, r);
+            return intersects(r, p, f);
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const line<T1>& l,
-                const rect<T2>& r) {
-            return intersects(r, l);
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const vec2<T1>& p,
+                const rect<T2>& r, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(p, r, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const rect<T1>& r1,
-                const rect<T2>& r2) {
-            return {}; // TODO
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const line<T1>& l, const rect<T2>& r,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, l, r);
+            return intersects(r, l, f);
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const circle<T1>& c,
-                const rect<T2>& r) {
-            return {}; // TODO
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const line<T1>& l,
+                const rect<T2>& r, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(l, r, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const rect<T1>& r1, const rect<T2>& r2,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, r1, r2);
+            if (!detail::meets(r1, r2)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            for (auto i = 0; i < 4; ++i) {
+                const bool more = intersects(r1, r2.side(i),
+                        [&f, &hit](const vec2<T2>& p) {
+                    hit = true;
+                    return detail::visit(f, p);
+                });
+                if (!more) {
+                    JNF_GEOMETRY_HIT(true);
+                    return false;
+                }
+            }
+            JNF_GEOMETRY_HIT(hit);
+            return true;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const rect<T1>& r1,
+                const rect<T2>& r2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(r1, r2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const circle<T1>& c, const rect<T2>& r,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c, r);
+            if (detail::clear_of(c, r)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            for (auto i = 0; i < 4; ++i) {
+                const bool more = intersects(c, r.side(i),
+                        [&f, &hit](const vec2<T2>& p) {
+                    hit = true;
+                    return detail::visit(f, p);
+                });
+                if (!more) {
+                    JNF_GEOMETRY_HIT(true);
+                    return false;
+                }
+            }
+            JNF_GEOMETRY_HIT(hit);
+            return true;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const circle<T1>& c,
+                const rect<T2>& r, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c, r, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const vec2<T1>& p, const circle<T2>& c) {
-            return false;
+            JNF_GEOMETRY_PROBE(contains, p, c);
+            return JNF_GEOMETRY_RESULT(false);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const line<T1>& l, const circle<T2>& c) {
-            return false;
+            JNF_GEOMETRY_PROBE(contains, l, c);
+            return JNF_GEOMETRY_RESULT(false);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const rect<T1>& r, const circle<T2>& c) {
-            return r.pos.x + c.radius <= c.pos.x
-                    && r.pos.y + c.radius <= c.pos.y
-                    && c.pos.x <= r.pos.x + r.size.x - c.radius
-                    && c.pos.y <= r.pos.y + r.size.y - c.radius;
+            JNF_GEOMETRY_PROBE(contains, r, c);
+            return JNF_GEOMETRY_RESULT(r.pos.x + c.radius <= c.center.x
+                    && r.pos.y + c.radius <= c.center.y
+                    && c.center.x <= r.pos.x + r.size.x - c.radius
+                    && c.center.y <= r.pos.y + r.size.y - c.radius);
         }
 
         template<typename T1, typename T2>
         inline constexpr bool contains(const circle<T1>& c1,
                 const circle<T2>& c2) {
-            return (c1.pos - c2.pos).mag2() <= (c1.radius - c2.radius)
-                    * (c1.radius - c2.radius);
+            JNF_GEOMETRY_PROBE(contains, c1, c2);
+            return JNF_GEOMETRY_RESULT((c1.center - c2.center).mag2()
+                    <= (c1.radius - c2.radius) * (c1.radius - c2.radius));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const vec2<T1>& p, const circle<T2>& c) {
-            return overlaps(c, p);
+            JNF_GEOMETRY_PROBE(overlaps, p, c);
+            return JNF_GEOMETRY_RESULT(overlaps(c, p));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const line<T1>& l, const circle<T2>& c) {
-            return overlaps(c, l);
+            JNF_GEOMETRY_PROBE(overlaps, l, c);
+            return JNF_GEOMETRY_RESULT(overlaps(c, l));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const rect<T1>& r, const circle<T2>& c) {
-            return overlaps(c, r);
+            JNF_GEOMETRY_PROBE(overlaps, r, c);
+            return JNF_GEOMETRY_RESULT(overlaps(c, r));
         }
 
         template<typename T1, typename T2>
         inline constexpr bool overlaps(const circle<T1>& c1,
                 const circle<T2>& c2) {
-            return (c1.pos - c2.pos).mag2() <= (c1.radius + c2.radius)
-                    * (c1.radius + c2.radius);
+            JNF_GEOMETRY_PROBE(overlaps, c1, c2);
+            return JNF_GEOMETRY_RESULT((c1.center - c2.center).mag2()
+                    <= (c1.radius + c2.radius) * (c1.radius + c2.radius));
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const vec2<T1>& p, const circle<T2>& c,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, p, c);
+            return intersects(c, p, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const vec2<T1>& p,
+                const circle<T2>& c, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(p, c, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const vec2<T1>& p,
-                const circle<T2>& c) {
-            return intersects(c, p);
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const line<T1>& l, const circle<T2>& c,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, l, c);
+            return intersects(c, l, f);
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const line<T1>& l,
-                const circle<T2>& c) {
-            return intersects(c, l);
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const line<T1>& l,
+                const circle<T2>& c, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(l, c, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const rect<T1>& r,
-                const circle<T2>& c) {
-            return intersects(c, r);
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const rect<T1>& r, const circle<T2>& c,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, r, c);
+            return intersects(c, r, f);
         }
 
-        template<typename T1, typename T2>
-        inline std::vector<vec2<T2>> intersects(const circle<T1>& c1,
-                const circle<T2>& c2) {
-            return {}; // TODO
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const rect<T1>& r,
+                const circle<T2>& c, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(r, c, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const circle<T1>& c1, const circle<T2>& c2,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c1, c2);
+            const auto d = c2.center - c1.center;
+            const auto m2 = d.mag2();
+            if (m2 == 0) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            const auto m = std::sqrt(m2);
+            const auto r2 = c1.radius * c1.radius;
+            const auto a = (r2 - c2.radius * c2.radius + m2) / (2 * m);
+            const auto q = c1.center + d * (a / m);
+            const auto h2 = r2 - a * a;
+            if (std::abs(h2) < eps) {
+                JNF_GEOMETRY_HIT(true);
+                return detail::visit(f, q);
+            }
+            if (h2 < 0) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            const auto h = d.perp() * (std::sqrt(h2) / m);
+            JNF_GEOMETRY_HIT(true);
+            return detail::visit(f, q + h) && detail::visit(f, q - h);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const circle<T1>& c1,
+                const circle<T2>& c2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c1, c2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
         }
 
         template<typename T>
@@ -598,7 +1027,7 @@ namespace jnf {
 
         template<typename T>
         inline constexpr circle<T> envelope_c(const line<T>& l) {
-            return {l.point(0.5), l.length() / 2};
+            return circle<T>(l.point(0.5), l.length() / 2);
         }
 
         template<typename T>
@@ -618,10 +1047,10 @@ namespace jnf {
 
         template<typename T>
         inline constexpr rect<T> envelope_r(const line<T>& l) {
-            return {{std::min(l.start.x, l.end.x),
+            return rect<T>({std::min(l.start.x, l.end.x),
                     std::min(l.start.y, l.end.y)},
                     {std::abs(l.start.x - l.end.x),
-                    std::abs(l.start.y - l.end.y)}};
+                    std::abs(l.start.y - l.end.y)});
         }
 
         template<typename T>
@@ -631,9 +1060,487 @@ namespace jnf {
 
         template<typename T>
         inline constexpr rect<T> envelope_r(const circle<T>& c) {
-            return rect<T>(c.pos - vec2<T>(c.radius, c.radius),
+            return rect<T>(c.center - vec2<T>(c.radius, c.radius),
                     vec2<T>(c.radius * 2, c.radius * 2));
         }
+
+        template<typename T>
+        inline constexpr rect<T> envelope_r(const rect<T>& r1,
+                const rect<T>& r2) {
+            const auto lo = r1.pos.min(r2.pos);
+            return rect<T>(lo, (r1.pos + r1.size).max(r2.pos + r2.size) - lo);
+        }
+
+        namespace detail {
+            template <typename S>
+            struct scalar;
+
+            template <typename T>
+            struct scalar<vec2<T>> {
+                using type = T;
+            };
+
+            template <typename T>
+            struct scalar<line<T>> {
+                using type = T;
+            };
+
+            template <typename T>
+            struct scalar<rect<T>> {
+                using type = T;
+            };
+
+            template <typename T>
+            struct scalar<circle<T>> {
+                using type = T;
+            };
+
+            template <typename S>
+            using scalar_t = typename scalar<S>::type;
+
+            template <typename S>
+            inline constexpr bool is_rect_v = false;
+
+            template <typename T>
+            inline constexpr bool is_rect_v<rect<T>> = true;
+
+            template <typename S>
+            inline constexpr bool is_vec2_v = false;
+
+            template <typename T>
+            inline constexpr bool is_vec2_v<vec2<T>> = true;
+
+            template <typename S>
+            inline constexpr bool is_line_v = false;
+
+            template <typename T>
+            inline constexpr bool is_line_v<line<T>> = true;
+
+            // Input iterator over anything exposing bool next(value_type&),
+            // ending at std::default_sentinel.
+            template <typename G>
+            class pull_iterator {
+            public:
+                using value_type = typename G::value_type;
+                using difference_type = std::ptrdiff_t;
+
+                inline pull_iterator() = default;
+
+                inline explicit pull_iterator(G* g) : g_(g) {
+                    ++*this;
+                }
+
+                inline const value_type& operator*() const {
+                    return v_;
+                }
+
+                inline pull_iterator& operator++() {
+                    if (!g_->next(v_)) {
+                        g_ = nullptr;
+                    }
+                    return *this;
+                }
+
+                inline void operator++(int) {
+                    ++*this;
+                }
+
+                inline bool operator==(std::default_sentinel_t) const {
+                    return g_ == nullptr;
+                }
+
+            private:
+                G* g_ = nullptr;
+                value_type v_{};
+            };
+        }
+
+        namespace detail {
+            // How intersection_generator cuts intersects(a, b) into parts
+            // run one at a time as the caller advances: count parts, visited
+            // in the order intersects visits their points, of which part k
+            // is run by visit(a, b, k, f). visit returns false when no later
+            // part can yield points, after an early reject or once a point
+            // was reported. size bounds the points a part can visit. The
+            // default runs the pair whole, which is right for the pairs
+            // yielding at most two points; pairs that walk sides or pieces
+            // of a boundary specialize this next to their intersects.
+            template <typename S1, typename S2>
+            struct lazy_parts {
+                static constexpr std::int32_t count = 1;
+                static constexpr std::int32_t size = 2;
+
+                template <typename F>
+                static inline bool visit(const S1& a, const S2& b,
+                        const std::int32_t, F& f) {
+                    intersects(a, b, f);
+                    return false;
+                }
+            };
+
+            // The parts of a pair that intersects forwards to the mirrored
+            // pair.
+            template <typename P>
+            struct mirrored_parts {
+                static constexpr std::int32_t count = P::count;
+                static constexpr std::int32_t size = P::size;
+
+                template <typename S1, typename S2, typename F>
+                static inline bool visit(const S1& a, const S2& b,
+                        const std::int32_t k, F& f) {
+                    return P::visit(b, a, k, f);
+                }
+            };
+
+            // A point on a boundary is reported once, from the first side
+            // holding it.
+            template <typename T1, typename T2>
+            struct lazy_parts<rect<T1>, vec2<T2>> {
+                static constexpr std::int32_t count = 4;
+                static constexpr std::int32_t size = 1;
+
+                template <typename F>
+                static inline bool visit(const rect<T1>& r,
+                        const vec2<T2>& p, const std::int32_t k, F& f) {
+                    bool found = false;
+                    intersects(r.side(k), p, [&f, &found](const auto& q) {
+                        found = true;
+                        return detail::visit(f, q);
+                    });
+                    return !found;
+                }
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<rect<T1>, line<T2>> {
+                static constexpr std::int32_t count = 4;
+                static constexpr std::int32_t size = 1;
+
+                template <typename F>
+                static inline bool visit(const rect<T1>& r,
+                        const line<T2>& l, const std::int32_t k, F& f) {
+                    if (k == 0 && !meets(r, envelope_r(l))) {
+                        return false;
+                    }
+                    intersects(r.side(k), l, f);
+                    return true;
+                }
+            };
+
+            // A side of r2 can cross r1 at two points, and at up to four
+            // when it passes through corners.
+            template <typename T1, typename T2>
+            struct lazy_parts<rect<T1>, rect<T2>> {
+                static constexpr std::int32_t count = 4;
+                static constexpr std::int32_t size = 4;
+
+                template <typename F>
+                static inline bool visit(const rect<T1>& r1,
+                        const rect<T2>& r2, const std::int32_t k, F& f) {
+                    if (k == 0 && !meets(r1, r2)) {
+                        return false;
+                    }
+                    intersects(r1, r2.side(k), f);
+                    return true;
+                }
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<circle<T1>, rect<T2>> {
+                static constexpr std::int32_t count = 4;
+                static constexpr std::int32_t size = 2;
+
+                template <typename F>
+                static inline bool visit(const circle<T1>& c,
+                        const rect<T2>& r, const std::int32_t k, F& f) {
+                    if (k == 0 && clear_of(c, r)) {
+                        return false;
+                    }
+                    intersects(c, r.side(k), f);
+                    return true;
+                }
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<vec2<T1>, rect<T2>>
+                    : mirrored_parts<lazy_parts<rect<T2>, vec2<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<line<T1>, rect<T2>>
+                    : mirrored_parts<lazy_parts<rect<T2>, line<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<rect<T1>, circle<T2>>
+                    : mirrored_parts<lazy_parts<circle<T2>, rect<T1>>> {
+            };
+        }
+
+        // Pull-based intersects(a, b). Points come out in the same order as
+        // from intersects, but shapes whose boundary intersects walks side by
+        // side or piece by piece are only intersected one part at a time as
+        // the caller advances, so stopping at the first point skips the
+        // remaining parts. Pending points live in an inline buffer sized to
+        // the most one part can yield, and nothing is allocated.
+        template <typename S1, typename S2>
+        class intersection_generator {
+        public:
+            using value_type = vec2<detail::scalar_t<S2>>;
+
+            using iterator = detail::pull_iterator<intersection_generator>;
+
+            inline intersection_generator(const S1& a, const S2& b)
+                    : a_(a), b_(b) {
+            }
+
+            inline bool next(value_type& p) {
+                while (i_ == n_) {
+                    if (part_ == parts::count) {
+                        return false;
+                    }
+                    fill(part_++);
+                }
+                p = buf_[i_++];
+                return true;
+            }
+
+            inline iterator begin() {
+                return iterator(this);
+            }
+
+            inline std::default_sentinel_t end() const {
+                return {};
+            }
+
+        private:
+            using parts = detail::lazy_parts<S1, S2>;
+
+            S1 a_;
+            S2 b_;
+            value_type buf_[parts::size];
+            std::int32_t n_ = 0;
+            std::int32_t i_ = 0;
+            std::int32_t part_ = 0;
+
+            inline void fill(const std::int32_t k) {
+                i_ = 0;
+                n_ = 0;
+                auto push = [this](const value_type& p) {
+                    buf_[n_++] = p;
+                };
+                if (!parts::visit(a_, b_, k, push)) {
+                    part_ = parts::count;
+                }
+            }
+        };
+
+        template <typename S1, typename S2>
+        inline intersection_generator<S1, S2> lazy_intersects(const S1& a,
+                const S2& b) {
+            return intersection_generator<S1, S2>(a, b);
+        }
+
+        template <typename S1, typename S2>
+        inline std::optional<vec2<detail::scalar_t<S2>>> first_intersection(
+                const S1& a, const S2& b) {
+            intersection_generator<S1, S2> g(a, b);
+            vec2<detail::scalar_t<S2>> p;
+            if (g.next(p)) {
+                return p;
+            }
+            return std::nullopt;
+        }
+
+        // Closest pair of points between two shapes, as a line from a point
+        // of the first to a point of the second. Rects and circles are taken
+        // as solid, so overlapping shapes give a degenerate line at a common
+        // point and distance zero.
+        template<typename T>
+        inline line<T> closest_pair(const vec2<T>& p1, const vec2<T>& p2) {
+            return line<T>(p1, p2);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const line<T>& l, const vec2<T>& p) {
+            return line<T>(closest(l, p), p);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const rect<T>& r, const vec2<T>& p) {
+            return line<T>(p.clamp(r.pos, r.pos + r.size), p);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const circle<T>& c, const vec2<T>& p) {
+            const auto d = p - c.center;
+            const auto m2 = d.mag2();
+            if (m2 <= c.radius * c.radius) {
+                return line<T>(p, p);
+            }
+            return line<T>(c.center + d * T(c.radius / std::sqrt(m2)), p);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const line<T>& l1, const line<T>& l2) {
+            const auto r = l1.vec();
+            const auto s = l2.vec();
+            const auto qp = l2.start - l1.start;
+            const auto d = r.cross(s);
+            if (d != 0) {
+                const auto t = qp.cross(s) / d;
+                const auto u = qp.cross(r) / d;
+                if (t >= 0 && t <= 1 && u >= 0 && u <= 1) {
+                    const auto x = l1.start + r * T(t);
+                    return line<T>(x, x);
+                }
+            }
+            // Apart (or parallel): the minimum is attained at an endpoint.
+            line<T> best(closest(l1, l2.start), l2.start);
+            auto d_min = best.length2();
+            const line<T> c[] = {
+                line<T>(closest(l1, l2.end), l2.end),
+                line<T>(l1.start, closest(l2, l1.start)),
+                line<T>(l1.end, closest(l2, l1.end))
+            };
+            for (const auto& l : c) {
+                const auto d2 = l.length2();
+                if (d2 < d_min) {
+                    best = l;
+                    d_min = d2;
+                }
+            }
+            return best;
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const rect<T>& r, const line<T>& l) {
+            if (contains(r, l.start)) {
+                return line<T>(l.start, l.start);
+            }
+            auto best = closest_pair(r.side(0), l);
+            auto d_min = best.length2();
+            for (auto i = 1; i < 4 && d_min > 0; ++i) {
+                const auto c = closest_pair(r.side(i), l);
+                const auto d2 = c.length2();
+                if (d2 < d_min) {
+                    best = c;
+                    d_min = d2;
+                }
+            }
+            return best;
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const circle<T>& c, const line<T>& l) {
+            const auto q = closest(l, c.center);
+            return line<T>(closest_pair(c, q).start, q);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const rect<T>& r1, const rect<T>& r2) {
+            // Per axis either the facing edges or the middle of the overlap.
+            const auto axis = [](const T a0, const T a1, const T b0,
+                    const T b1, T& pa, T& pb) {
+                if (a1 < b0) {
+                    pa = a1;
+                    pb = b0;
+                } else if (b1 < a0) {
+                    pa = a0;
+                    pb = b1;
+                } else {
+                    pa = pb = (std::max(a0, b0) + std::min(a1, b1)) / 2;
+                }
+            };
+            vec2<T> p1, p2;
+            axis(r1.pos.x, r1.pos.x + r1.size.x, r2.pos.x,
+                    r2.pos.x + r2.size.x, p1.x, p2.x);
+            axis(r1.pos.y, r1.pos.y + r1.size.y, r2.pos.y,
+                    r2.pos.y + r2.size.y, p1.y, p2.y);
+            return line<T>(p1, p2);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const circle<T>& c, const rect<T>& r) {
+            const auto q = c.center.clamp(r.pos, r.pos + r.size);
+            return line<T>(closest_pair(c, q).start, q);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const circle<T>& c1, const circle<T>& c2) {
+            const auto d = c2.center - c1.center;
+            const auto m = d.mag();
+            if (m == 0) {
+                return line<T>(c1.center, c1.center);
+            }
+            const auto u = d * T(1 / m);
+            if (m <= c1.radius + c2.radius) {
+                // On the center line, inside both discs.
+                const auto x = c1.center
+                        + u * T(std::max(m - c2.radius, decltype(m)(0)));
+                return line<T>(x, x);
+            }
+            return line<T>(c1.center + u * c1.radius,
+                    c2.center - u * c2.radius);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const vec2<T>& p, const line<T>& l) {
+            const auto c = closest_pair(l, p);
+            return line<T>(c.end, c.start);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const vec2<T>& p, const rect<T>& r) {
+            const auto c = closest_pair(r, p);
+            return line<T>(c.end, c.start);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const vec2<T>& p, const circle<T>& c) {
+            const auto l = closest_pair(c, p);
+            return line<T>(l.end, l.start);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const line<T>& l, const rect<T>& r) {
+            const auto c = closest_pair(r, l);
+            return line<T>(c.end, c.start);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const line<T>& l, const circle<T>& c) {
+            const auto p = closest_pair(c, l);
+            return line<T>(p.end, p.start);
+        }
+
+        template<typename T>
+        inline line<T> closest_pair(const rect<T>& r, const circle<T>& c) {
+            const auto p = closest_pair(c, r);
+            return line<T>(p.end, p.start);
+        }
+
+        template<typename S1, typename S2>
+        inline detail::scalar_t<S1> distance(const S1& a, const S2& b) {
+            return closest_pair(a, b).length();
+        }
+
+        // distance(a, b) if it is at most bound. Pairs whose envelopes are
+        // already further apart than bound are rejected on the boxes alone,
+        // without running the exact query.
+        template<typename S1, typename S2>
+        inline std::optional<detail::scalar_t<S1>> distance_within(
+                const S1& a, const S2& b, const detail::scalar_t<S1> bound) {
+            if (closest_pair(envelope_r(a), envelope_r(b)).length2()
+                    > bound * bound) {
+                return std::nullopt;
+            }
+            const auto d = distance(a, b);
+            if (d > bound) {
+                return std::nullopt;
+            }
+            return d;
+        }
     }
 }
 
@@ -0,0 +1,507 @@
+#ifndef JNF_GEOMETRY_BVH_H
+#define JNF_GEOMETRY_BVH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "jnf_geometry.h"
+
+namespace jnf {
+    namespace geometry {
+        // Dynamic bounding volume hierarchy over envelope_r boxes. Leaves are
+        // updated in place when their shape moves and only the boxes of their
+        // ancestors are refitted, either immediately (update) or batched for
+        // the whole frame (set + refit). Tree quality is maintained with
+        // local rotations that swap a child with a grandchild whenever that
+        // shrinks the parent's box, applied along every refitted path and
+        // incrementally through optimize(); rebuild() is the fallback for
+        // when the scene has changed completely.
+        template <typename T>
+        class dynamic_bvh {
+        public:
+            static constexpr std::int32_t null = -1;
+
+            inline std::int32_t insert(const rect<T>& box,
+                    const std::uint32_t id) {
+                const auto leaf = allocate();
+                auto& n = nodes_[leaf];
+                n.box = box;
+                n.id = id;
+                n.height = 0;
+                link(leaf);
+                ++leaves_;
+                return leaf;
+            }
+
+            template <typename S>
+            inline std::int32_t insert(const S& shape,
+                    const std::uint32_t id) {
+                return insert(envelope_r(shape), id);
+            }
+
+            inline void remove(const std::int32_t leaf) {
+                unlink(leaf);
+                release(leaf);
+                --leaves_;
+            }
+
+            // Moves a leaf and refits its ancestors right away.
+            inline void update(const std::int32_t leaf, const rect<T>& box) {
+                nodes_[leaf].box = box;
+                refit_path(nodes_[leaf].parent);
+            }
+
+            template <typename S>
+            inline void update(const std::int32_t leaf, const S& shape) {
+                update(leaf, envelope_r(shape));
+            }
+
+            // Moves a leaf without touching its ancestors; call refit() once
+            // all leaves of the frame have been set. Ancestors are marked on
+            // the way up so that refit() only visits the affected subtrees.
+            inline void set(const std::int32_t leaf, const rect<T>& box) {
+                nodes_[leaf].box = box;
+                auto i = nodes_[leaf].parent;
+                while (i != null && !nodes_[i].dirty) {
+                    nodes_[i].dirty = true;
+                    i = nodes_[i].parent;
+                }
+            }
+
+            template <typename S>
+            inline void set(const std::int32_t leaf, const S& shape) {
+                set(leaf, envelope_r(shape));
+            }
+
+            inline void refit() {
+                if (root_ == null || !nodes_[root_].dirty) {
+                    return;
+                }
+                // Post-order walk restricted to dirty nodes.
+                stack_.clear();
+                stack_.push_back(root_);
+                while (!stack_.empty()) {
+                    const auto i = stack_.back();
+                    auto& n = nodes_[i];
+                    const auto& l = nodes_[n.left];
+                    const auto& r = nodes_[n.right];
+                    if (l.dirty) {
+                        stack_.push_back(n.left);
+                        continue;
+                    }
+                    if (r.dirty) {
+                        stack_.push_back(n.right);
+                        continue;
+                    }
+                    stack_.pop_back();
+                    n.dirty = false;
+                    fix(i);
+                    rotate(i);
+                }
+            }
+
+            // Attempts a rotation at up to budget internal nodes, continuing
+            // where the previous call stopped.
+            inline void optimize(std::size_t budget) {
+                const auto size = static_cast<std::int32_t>(nodes_.size());
+                for (std::int32_t k = 0; k < size && budget > 0; ++k) {
+                    cursor_ = (cursor_ + 1) % size;
+                    const auto& n = nodes_[cursor_];
+                    if (n.height > 1 && !n.free) {
+                        rotate(cursor_);
+                        --budget;
+                    }
+                }
+            }
+
+            // Discards the hierarchy and rebuilds it top-down from the leaves
+            // by median splits along the longest axis of the leaf centres.
+            inline void rebuild() {
+                std::vector<std::int32_t> leaves;
+                leaves.reserve(leaves_);
+                for (std::int32_t i = 0;
+                        i < static_cast<std::int32_t>(nodes_.size()); ++i) {
+                    if (nodes_[i].free) {
+                        continue;
+                    }
+                    if (nodes_[i].height == 0) {
+                        leaves.push_back(i);
+                    } else {
+                        release(i);
+                    }
+                }
+                root_ = leaves.empty() ? null
+                        : build(leaves.data(), leaves.data() + leaves.size());
+                if (root_ != null) {
+                    nodes_[root_].parent = null;
+                }
+            }
+
+            // Calls f(id) for every leaf whose box meets the query box, edges
+            // included. If f returns bool, returning false stops the query.
+            template <typename F>
+            inline void query(const rect<T>& box, F&& f) const {
+                if (root_ == null) {
+                    return;
+                }
+                std::int32_t stack[64];
+                std::vector<std::int32_t> spill;
+                std::size_t top = 0;
+                stack[top++] = root_;
+                while (top > 0 || !spill.empty()) {
+                    std::int32_t i;
+                    if (!spill.empty()) {
+                        i = spill.back();
+                        spill.pop_back();
+                    } else {
+                        i = stack[--top];
+                    }
+                    const auto& n = nodes_[i];
+                    if (!detail::meets(n.box, box)) {
+                        continue;
+                    }
+                    if (n.height == 0) {
+                        if constexpr (std::is_void_v<
+                                std::invoke_result_t<F&, std::uint32_t>>) {
+                            f(n.id);
+                        } else if (!f(n.id)) {
+                            return;
+                        }
+                        continue;
+                    }
+                    for (const auto c : {n.left, n.right}) {
+                        if (top < 64) {
+                            stack[top++] = c;
+                        } else {
+                            spill.push_back(c);
+                        }
+                    }
+                }
+            }
+
+            template <typename S, typename F>
+            inline void query(const S& shape, F&& f) const {
+                query(envelope_r(shape), f);
+            }
+
+            // Lazily evaluated query: candidate ids are produced one at a
+            // time as the caller advances, so abandoning the range skips the
+            // rest of the traversal. reset() starts a new query and keeps the
+            // traversal stack's storage.
+            class query_range {
+            public:
+                using value_type = std::uint32_t;
+                using iterator = detail::pull_iterator<query_range>;
+
+                inline query_range(const dynamic_bvh& tree,
+                        const rect<T>& box) : tree_(&tree) {
+                    reset(box);
+                }
+
+                inline void reset(const rect<T>& box) {
+                    box_ = box;
+                    stack_.clear();
+                    if (tree_->root_ != null) {
+                        stack_.push_back(tree_->root_);
+                    }
+                }
+
+                inline bool next(std::uint32_t& id) {
+                    while (!stack_.empty()) {
+                        const auto& n = tree_->nodes_[stack_.back()];
+                        stack_.pop_back();
+                        if (!detail::meets(n.box, box_)) {
+                            continue;
+                        }
+                        if (n.height == 0) {
+                            id = n.id;
+                            return true;
+                        }
+                        stack_.push_back(n.right);
+                        stack_.push_back(n.left);
+                    }
+                    return false;
+                }
+
+                inline iterator begin() {
+                    return iterator(this);
+                }
+
+                inline std::default_sentinel_t end() const {
+                    return {};
+                }
+
+            private:
+                const dynamic_bvh* tree_;
+                rect<T> box_;
+                std::vector<std::int32_t> stack_;
+            };
+
+            inline query_range candidates(const rect<T>& box) const {
+                return query_range(*this, box);
+            }
+
+            template <typename S>
+            inline query_range candidates(const S& shape) const {
+                return query_range(*this, envelope_r(shape));
+            }
+
+            inline const rect<T>& bounds(const std::int32_t node) const {
+                return nodes_[node].box;
+            }
+
+            inline std::uint32_t id(const std::int32_t leaf) const {
+                return nodes_[leaf].id;
+            }
+
+            inline std::size_t size() const {
+                return leaves_;
+            }
+
+            // Structure access for walking the hierarchy; both children are
+            // null at leaves.
+            inline std::int32_t root() const {
+                return root_;
+            }
+
+            inline std::int32_t left(const std::int32_t node) const {
+                return nodes_[node].left;
+            }
+
+            inline std::int32_t right(const std::int32_t node) const {
+                return nodes_[node].right;
+            }
+
+            inline std::int32_t height() const {
+                return root_ == null ? 0 : nodes_[root_].height;
+            }
+
+            // Sum of the internal node perimeters relative to the root's, the
+            // surface area heuristic cost used to judge tree quality.
+            inline T cost() const {
+                if (root_ == null || nodes_[root_].height == 0) {
+                    return T(0);
+                }
+                T sum = T(0);
+                for (const auto& n : nodes_) {
+                    if (!n.free && n.height > 0) {
+                        sum += n.box.perim();
+                    }
+                }
+                return sum / nodes_[root_].box.perim();
+            }
+
+        private:
+            struct node {
+                rect<T> box;
+                std::int32_t parent = null;
+                std::int32_t left = null;
+                std::int32_t right = null;
+                std::int32_t height = 0;
+                std::uint32_t id = 0;
+                bool dirty = false;
+                bool free = false;
+            };
+
+            std::vector<node> nodes_;
+            std::vector<std::int32_t> stack_;
+            std::int32_t root_ = null;
+            std::int32_t free_ = null;
+            std::int32_t cursor_ = 0;
+            std::size_t leaves_ = 0;
+
+            inline std::int32_t allocate() {
+                if (free_ == null) {
+                    nodes_.emplace_back();
+                    return static_cast<std::int32_t>(nodes_.size() - 1);
+                }
+                const auto i = free_;
+                free_ = nodes_[i].parent;
+                nodes_[i] = node();
+                return i;
+            }
+
+            inline void release(const std::int32_t i) {
+                nodes_[i].free = true;
+                nodes_[i].parent = free_;
+                free_ = i;
+            }
+
+            static inline T perim(const rect<T>& r) {
+                return r.perim();
+            }
+
+            inline void fix(const std::int32_t i) {
+                auto& n = nodes_[i];
+                n.box = envelope_r(nodes_[n.left].box, nodes_[n.right].box);
+                n.height = 1 + std::max(nodes_[n.left].height,
+                        nodes_[n.right].height);
+            }
+
+            inline void replace_child(const std::int32_t parent,
+                    const std::int32_t from, const std::int32_t to) {
+                auto& p = nodes_[parent];
+                (p.left == from ? p.left : p.right) = to;
+                nodes_[to].parent = parent;
+            }
+
+            // Picks the sibling by the branch and bound descent of the surface
+            // area heuristic and splices a new parent above it.
+            inline void link(const std::int32_t leaf) {
+                if (root_ == null) {
+                    root_ = leaf;
+                    nodes_[leaf].parent = null;
+                    return;
+                }
+                const auto box = nodes_[leaf].box;
+                auto i = root_;
+                while (nodes_[i].height > 0) {
+                    const auto& n = nodes_[i];
+                    const T area = perim(n.box);
+                    const T combined = perim(envelope_r(n.box, box));
+                    const T here = T(2) * combined;
+                    const T inherited = T(2) * (combined - area);
+                    auto descend = [&](const std::int32_t c) {
+                        const auto& cn = nodes_[c];
+                        const T grown = perim(envelope_r(cn.box, box));
+                        return (cn.height == 0 ? grown : grown - perim(cn.box))
+                                + inherited;
+                    };
+                    const T cl = descend(n.left);
+                    const T cr = descend(n.right);
+                    if (here < cl && here < cr) {
+                        break;
+                    }
+                    i = cl < cr ? n.left : n.right;
+                }
+
+                const auto sibling = i;
+                const auto old_parent = nodes_[sibling].parent;
+                const auto parent = allocate();
+                nodes_[parent].left = sibling;
+                nodes_[parent].right = leaf;
+                nodes_[sibling].parent = parent;
+                nodes_[leaf].parent = parent;
+                if (old_parent == null) {
+                    root_ = parent;
+                    nodes_[parent].parent = null;
+                } else {
+                    replace_child(old_parent, sibling, parent);
+                }
+                refit_path(parent);
+            }
+
+            inline void unlink(const std::int32_t leaf) {
+                if (leaf == root_) {
+                    root_ = null;
+                    return;
+                }
+                const auto parent = nodes_[leaf].parent;
+                const auto grand = nodes_[parent].parent;
+                const auto sibling = nodes_[parent].left == leaf
+                        ? nodes_[parent].right : nodes_[parent].left;
+                if (grand == null) {
+                    root_ = sibling;
+                    nodes_[sibling].parent = null;
+                } else {
+                    replace_child(grand, parent, sibling);
+                    refit_path(grand);
+                }
+                release(parent);
+            }
+
+            inline void refit_path(std::int32_t i) {
+                while (i != null) {
+                    fix(i);
+                    rotate(i);
+                    i = nodes_[i].parent;
+                }
+            }
+
+            // Tries the four child/grandchild swaps below node a and applies
+            // the one that shrinks the swapped-into child the most. The box of
+            // a itself is unchanged since it still covers the same leaves.
+            // Nodes with pending set() updates below them are left alone so
+            // that refit() still finds every stale box.
+            inline void rotate(const std::int32_t a) {
+                if (nodes_[a].height < 2 || nodes_[a].dirty) {
+                    return;
+                }
+                const auto b = nodes_[a].left;
+                const auto c = nodes_[a].right;
+                T best = T(0);
+                std::int32_t from = null;
+                std::int32_t to = null;
+                std::int32_t host = null;
+                auto consider = [&](const std::int32_t x,
+                        const std::int32_t y) {
+                    // Swap x (child of a) with y (grandchild via the other
+                    // child of a).
+                    const auto h = nodes_[y].parent;
+                    const auto z = nodes_[h].left == y ? nodes_[h].right
+                            : nodes_[h].left;
+                    const T d = perim(envelope_r(nodes_[x].box, nodes_[z].box))
+                            - perim(nodes_[h].box);
+                    if (d < best) {
+                        best = d;
+                        from = x;
+                        to = y;
+                        host = h;
+                    }
+                };
+                if (nodes_[c].height > 0) {
+                    consider(b, nodes_[c].left);
+                    consider(b, nodes_[c].right);
+                }
+                if (nodes_[b].height > 0) {
+                    consider(c, nodes_[b].left);
+                    consider(c, nodes_[b].right);
+                }
+                if (from == null) {
+                    return;
+                }
+                replace_child(a, from, to);
+                replace_child(host, to, from);
+                fix(host);
+                fix(a);
+            }
+
+            inline std::int32_t build(std::int32_t* first,
+                    std::int32_t* last) {
+                if (last - first == 1) {
+                    return *first;
+                }
+                auto lo = nodes_[*first].box.center();
+                auto hi = lo;
+                for (auto it = first + 1; it != last; ++it) {
+                    const auto c = nodes_[*it].box.center();
+                    lo = lo.min(c);
+                    hi = hi.max(c);
+                }
+                const bool x = hi.x - lo.x >= hi.y - lo.y;
+                auto mid = first + (last - first) / 2;
+                std::nth_element(first, mid, last,
+                        [this, x](const std::int32_t i, const std::int32_t j) {
+                    const auto ci = nodes_[i].box.center();
+                    const auto cj = nodes_[j].box.center();
+                    return x ? ci.x < cj.x : ci.y < cj.y;
+                });
+                const auto l = build(first, mid);
+                const auto r = build(mid, last);
+                const auto p = allocate();
+                nodes_[p].left = l;
+                nodes_[p].right = r;
+                nodes_[l].parent = p;
+                nodes_[r].parent = p;
+                fix(p);
+                return p;
+            }
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_BVH_H
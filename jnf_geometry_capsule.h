@@ -0,0 +1,601 @@
+#ifndef JNF_GEOMETRY_CAPSULE_H
+#define JNF_GEOMETRY_CAPSULE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numbers>
+
+#include "jnf_geometry.h"
+
+namespace jnf {
+    namespace geometry {
+        // The points within radius of a segment. A circle moving over a
+        // frame sweeps the capsule between its two positions, so testing
+        // that capsule catches every contact the motion could have made,
+        // however fast, without substepping.
+        template <typename T>
+        struct capsule {
+            line<T> seg;
+            T radius;
+
+            inline explicit capsule(const line<T>& seg = line<T>(),
+                    const T radius = T(0)) : seg(seg), radius(radius) {
+            }
+
+            // The capsule swept by c moving by d.
+            static inline capsule swept(const circle<T>& c, const vec2<T>& d) {
+                return capsule(line<T>(c.center, c.center + d), c.radius);
+            }
+
+            inline circle<T> start_cap() const {
+                return circle<T>(seg.start, radius);
+            }
+
+            inline circle<T> end_cap() const {
+                return circle<T>(seg.end, radius);
+            }
+
+            // The straight parts of the boundary, undefined for a capsule
+            // whose segment has no length.
+            inline line<T> side(const int32_t i) const {
+                const auto n = seg.vec().perp().norm() * radius;
+                return i % 2 == 0 ? line<T>(seg.start + n, seg.end + n)
+                        : line<T>(seg.end - n, seg.start - n);
+            }
+
+            inline constexpr T area() const {
+                return T(2) * radius * seg.length()
+                        + std::numbers::pi_v<T> * radius * radius;
+            }
+
+            inline constexpr T perim() const {
+                return T(2) * seg.length()
+                        + T(2) * std::numbers::pi_v<T> * radius;
+            }
+        };
+
+        namespace detail {
+            // Part of a circle: the points p with (p - c.center).dot(dir)
+            // positive, or the whole circle when dir is zero.
+            template <typename T>
+            struct arc {
+                circle<T> c;
+                vec2<T> dir;
+
+                inline bool holds(const vec2<T>& p) const {
+                    return dir.mag2() == 0 || (p - c.center).dot(dir) > 0;
+                }
+            };
+
+            // Calls g on each piece of the boundary of a shape, as lines and
+            // arcs, until g returns false.
+            template <typename T, typename G>
+            inline bool pieces(const line<T>& l, G&& g) {
+                return g(l);
+            }
+
+            template <typename T, typename G>
+            inline bool pieces(const rect<T>& r, G&& g) {
+                for (auto i = 0; i < 4; ++i) {
+                    if (!g(r.side(i))) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            template <typename T, typename G>
+            inline bool pieces(const circle<T>& c, G&& g) {
+                return g(arc<T>{c, vec2<T>(T(0), T(0))});
+            }
+
+            // A capsule has two sides and two caps, or a single whole circle
+            // if its segment has no length.
+            template <typename T>
+            inline std::int32_t piece_count(const capsule<T>& c) {
+                return c.seg.vec().mag2() == 0 ? 1 : 4;
+            }
+
+            template <typename T, typename G>
+            inline bool piece(const capsule<T>& c, const std::int32_t k,
+                    G&& g) {
+                const auto d = c.seg.vec();
+                if (d.mag2() == 0) {
+                    return g(arc<T>{c.start_cap(), d});
+                }
+                switch (k) {
+                    case 0:
+                        return g(c.side(0));
+                    case 1:
+                        return g(arc<T>{c.end_cap(), d});
+                    case 2:
+                        return g(c.side(1));
+                    default:
+                        return g(arc<T>{c.start_cap(), -d});
+                }
+            }
+
+            template <typename T, typename G>
+            inline bool pieces(const capsule<T>& c, G&& g) {
+                const auto n = piece_count(c);
+                for (std::int32_t k = 0; k < n; ++k) {
+                    if (!piece(c, k, g)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            template <typename T, typename F>
+            inline bool cross(const line<T>& l1, const line<T>& l2, F& f) {
+                return intersects(l1, l2, f);
+            }
+
+            template <typename T, typename F>
+            inline bool cross(const arc<T>& a, const line<T>& l, F& f) {
+                return intersects(a.c, l, [&a, &f](const vec2<T>& p) {
+                    return !a.holds(p) || detail::visit(f, p);
+                });
+            }
+
+            template <typename T, typename F>
+            inline bool cross(const line<T>& l, const arc<T>& a, F& f) {
+                return cross(a, l, f);
+            }
+
+            template <typename T, typename F>
+            inline bool cross(const arc<T>& a1, const arc<T>& a2, F& f) {
+                return intersects(a1.c, a2.c, [&a1, &a2, &f](const vec2<T>& p) {
+                    return !a1.holds(p) || !a2.holds(p) || detail::visit(f, p);
+                });
+            }
+
+            // Boundary crossings of a capsule with another shape, piece by
+            // piece.
+            template <typename T, typename S, typename F>
+            inline bool crossings(const capsule<T>& c, const S& s, F& f,
+                    bool& hit) {
+                auto g = [&f, &hit](const auto& p) {
+                    hit = true;
+                    return detail::visit(f, p);
+                };
+                return pieces(c, [&s, &g](const auto& a) {
+                    return pieces(s, [&a, &g](const auto& b) {
+                        return cross(a, b, g);
+                    });
+                });
+            }
+        }
+
+        template<typename T1, typename T2>
+        inline vec2<T1> closest(const capsule<T1>& c, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(closest, c, p);
+            const auto q = closest(c.seg, p);
+            const auto d = p - q;
+            if (d.mag2() != 0) {
+                return q + d.norm() * c.radius;
+            }
+            const auto v = c.seg.vec();
+            return q + (v.mag2() != 0 ? v.perp().norm()
+                    : vec2<T1>(T1(1), T1(0))) * c.radius;
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const capsule<T1>& c, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(contains, c, p);
+            return JNF_GEOMETRY_RESULT(
+                    (closest(c.seg, p) - p).mag2() < c.radius * c.radius);
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const capsule<T1>& c, const line<T2>& l) {
+            JNF_GEOMETRY_PROBE(contains, c, l);
+            return JNF_GEOMETRY_RESULT(
+                    contains(c, l.start) && contains(c, l.end));
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const capsule<T1>& c, const rect<T2>& r) {
+            JNF_GEOMETRY_PROBE(contains, c, r);
+            return JNF_GEOMETRY_RESULT(contains(c, r.pos)
+                    && contains(c, vec2<T2>(r.pos.x + r.size.x, r.pos.y))
+                    && contains(c, vec2<T2>(r.pos.x, r.pos.y + r.size.y))
+                    && contains(c, r.pos + r.size));
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const capsule<T1>& c1, const circle<T2>& c2) {
+            JNF_GEOMETRY_PROBE(contains, c1, c2);
+            const auto d = c1.radius - c2.radius;
+            return JNF_GEOMETRY_RESULT(d >= 0
+                    && (closest(c1.seg, c2.center) - c2.center).mag2()
+                    <= d * d);
+        }
+
+        // A capsule is the hull of its end caps.
+        template<typename T1, typename T2>
+        inline bool contains(const capsule<T1>& c1, const capsule<T2>& c2) {
+            JNF_GEOMETRY_PROBE(contains, c1, c2);
+            return JNF_GEOMETRY_RESULT(contains(c1, c2.start_cap())
+                    && contains(c1, c2.end_cap()));
+        }
+
+        template<typename T1, typename T2>
+        inline constexpr bool contains(const vec2<T1>& p,
+                const capsule<T2>& c) {
+            JNF_GEOMETRY_PROBE(contains, p, c);
+            return JNF_GEOMETRY_RESULT(false);
+        }
+
+        template<typename T1, typename T2>
+        inline constexpr bool contains(const line<T1>& l,
+                const capsule<T2>& c) {
+            JNF_GEOMETRY_PROBE(contains, l, c);
+            return JNF_GEOMETRY_RESULT(false);
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const rect<T1>& r, const capsule<T2>& c) {
+            JNF_GEOMETRY_PROBE(contains, r, c);
+            return JNF_GEOMETRY_RESULT(contains(r, c.start_cap())
+                    && contains(r, c.end_cap()));
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const circle<T1>& c1, const capsule<T2>& c2) {
+            JNF_GEOMETRY_PROBE(contains, c1, c2);
+            const auto d = c1.radius - c2.radius;
+            return JNF_GEOMETRY_RESULT(d >= 0
+                    && (c2.seg.start - c1.center).mag2() <= d * d
+                    && (c2.seg.end - c1.center).mag2() <= d * d);
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const capsule<T1>& c, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(overlaps, c, p);
+            return JNF_GEOMETRY_RESULT(contains(c, p));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const capsule<T1>& c, const line<T2>& l) {
+            JNF_GEOMETRY_PROBE(overlaps, c, l);
+            return JNF_GEOMETRY_RESULT(closest_pair(c.seg, l).length2()
+                    <= c.radius * c.radius);
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const capsule<T1>& c, const rect<T2>& r) {
+            JNF_GEOMETRY_PROBE(overlaps, c, r);
+            return JNF_GEOMETRY_RESULT(closest_pair(r, c.seg).length2()
+                    <= c.radius * c.radius);
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const capsule<T1>& c1, const circle<T2>& c2) {
+            JNF_GEOMETRY_PROBE(overlaps, c1, c2);
+            const auto r = c1.radius + c2.radius;
+            return JNF_GEOMETRY_RESULT(
+                    (closest(c1.seg, c2.center) - c2.center).mag2() <= r * r);
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const capsule<T1>& c1, const capsule<T2>& c2) {
+            JNF_GEOMETRY_PROBE(overlaps, c1, c2);
+            const auto r = c1.radius + c2.radius;
+            return JNF_GEOMETRY_RESULT(
+                    closest_pair(c1.seg, c2.seg).length2() <= r * r);
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const vec2<T1>& p, const capsule<T2>& c) {
+            JNF_GEOMETRY_PROBE(overlaps, p, c);
+            return JNF_GEOMETRY_RESULT(overlaps(c, p));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const line<T1>& l, const capsule<T2>& c) {
+            JNF_GEOMETRY_PROBE(overlaps, l, c);
+            return JNF_GEOMETRY_RESULT(overlaps(c, l));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const rect<T1>& r, const capsule<T2>& c) {
+            JNF_GEOMETRY_PROBE(overlaps, r, c);
+            return JNF_GEOMETRY_RESULT(overlaps(c, r));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const circle<T1>& c1, const capsule<T2>& c2) {
+            JNF_GEOMETRY_PROBE(overlaps, c1, c2);
+            return JNF_GEOMETRY_RESULT(overlaps(c2, c1));
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const capsule<T1>& c, const vec2<T2>& p,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c, p);
+            const auto d = (closest(c.seg, p) - p).mag() - c.radius;
+            if (std::abs(d) < eps) {
+                JNF_GEOMETRY_HIT(true);
+                return detail::visit(f, p);
+            }
+            return true;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const capsule<T1>& c,
+                const vec2<T2>& p, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c, p, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const capsule<T1>& c, const line<T2>& l,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c, l);
+            if (!overlaps(c, l)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::crossings(c, l, f, hit);
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const capsule<T1>& c,
+                const line<T2>& l, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c, l, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const capsule<T1>& c, const rect<T2>& r,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c, r);
+            if (!overlaps(c, r)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::crossings(c, r, f, hit);
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const capsule<T1>& c,
+                const rect<T2>& r, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c, r, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const capsule<T1>& c1, const circle<T2>& c2,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c1, c2);
+            if (!overlaps(c1, c2)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::crossings(c1, c2, f, hit);
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const capsule<T1>& c1,
+                const circle<T2>& c2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c1, c2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const capsule<T1>& c1, const capsule<T2>& c2,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c1, c2);
+            if (!overlaps(c1, c2)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::crossings(c1, c2, f, hit);
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const capsule<T1>& c1,
+                const capsule<T2>& c2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c1, c2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const vec2<T1>& p, const capsule<T2>& c,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, p, c);
+            return intersects(c, p, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const vec2<T1>& p,
+                const capsule<T2>& c, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(p, c, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const line<T1>& l, const capsule<T2>& c,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, l, c);
+            return intersects(c, l, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const line<T1>& l,
+                const capsule<T2>& c, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(l, c, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const rect<T1>& r, const capsule<T2>& c,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, r, c);
+            return intersects(c, r, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const rect<T1>& r,
+                const capsule<T2>& c, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(r, c, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const circle<T1>& c1, const capsule<T2>& c2,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c1, c2);
+            return intersects(c2, c1, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const circle<T1>& c1,
+                const capsule<T2>& c2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c1, c2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T>
+        inline circle<T> envelope_c(const capsule<T>& c) {
+            return circle<T>((c.seg.start + c.seg.end) * T(0.5),
+                    c.seg.length() * T(0.5) + c.radius);
+        }
+
+        template<typename T>
+        inline rect<T> envelope_r(const capsule<T>& c) {
+            const vec2<T> lo(std::min(c.seg.start.x, c.seg.end.x),
+                    std::min(c.seg.start.y, c.seg.end.y));
+            const vec2<T> hi(std::max(c.seg.start.x, c.seg.end.x),
+                    std::max(c.seg.start.y, c.seg.end.y));
+            const vec2<T> r(c.radius, c.radius);
+            return rect<T>(lo - r, hi - lo + r * T(2));
+        }
+
+        namespace detail {
+            template <typename T>
+            struct scalar<capsule<T>> {
+                using type = T;
+            };
+
+            // intersection_generator walks a capsule piece by piece, like
+            // crossings. N bounds the crossings of one piece with s: two per
+            // piece of s.
+            template <typename T, typename S, std::int32_t N>
+            struct capsule_parts {
+                static constexpr std::int32_t count = 4;
+                static constexpr std::int32_t size = N;
+
+                template <typename F>
+                static inline bool visit(const capsule<T>& c, const S& s,
+                        const std::int32_t k, F& f) {
+                    if (k == 0 && !overlaps(c, s)) {
+                        return false;
+                    }
+                    if (k >= piece_count(c)) {
+                        return false;
+                    }
+                    piece(c, k, [&s, &f](const auto& a) {
+                        return pieces(s, [&a, &f](const auto& b) {
+                            return cross(a, b, f);
+                        });
+                    });
+                    return true;
+                }
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<capsule<T1>, line<T2>>
+                    : capsule_parts<T1, line<T2>, 2> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<capsule<T1>, rect<T2>>
+                    : capsule_parts<T1, rect<T2>, 8> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<capsule<T1>, circle<T2>>
+                    : capsule_parts<T1, circle<T2>, 2> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<capsule<T1>, capsule<T2>>
+                    : capsule_parts<T1, capsule<T2>, 8> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<vec2<T1>, capsule<T2>>
+                    : mirrored_parts<lazy_parts<capsule<T2>, vec2<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<line<T1>, capsule<T2>>
+                    : mirrored_parts<lazy_parts<capsule<T2>, line<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<rect<T1>, capsule<T2>>
+                    : mirrored_parts<lazy_parts<capsule<T2>, rect<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<circle<T1>, capsule<T2>>
+                    : mirrored_parts<lazy_parts<capsule<T2>, circle<T1>>> {
+            };
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_CAPSULE_H
@@ -0,0 +1,350 @@
+#ifndef JNF_GEOMETRY_CLIP_H
+#define JNF_GEOMETRY_CLIP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_hilbert.h"
+#include "jnf_geometry_io.h"
+#include "jnf_geometry_parallel.h"
+
+// Clipping to rect windows. Segments are clipped with the Liang-Barsky
+// method: the segment is taken as start + t * vec() and each of the four
+// slabs of the rect narrows the range of t, so a clip costs a handful of
+// divisions and never builds the sides of the rect. The rect is closed, so a
+// segment that only touches it is clipped to the touching point or part.
+//
+// The batch kernel works on structure-of-arrays spans and is written like
+// those of jnf_geometry_batch.h: no calls and no data dependent branches, so
+// its loops vectorize under -O3 (or -O2 -ftree-vectorize). GCC also needs
+// -fno-trapping-math before it turns the selects into blends.
+//
+// Polygons are clipped with the Sutherland-Hodgman method, one side of the
+// rect at a time, from one polygon_buffer into another, so a buffer kept
+// across tiles performs no allocations once its size settles. Polygons
+// wholly inside the rect are copied and those whose bounds miss it skipped
+// without clipping. The rect is closed here too, as in the index queries, and
+// a ring that only touches it clips to one with no area, which is dropped.
+// As usual with Sutherland-Hodgman, a concave ring cut into several pieces
+// stays one ring, the pieces joined by edges along the rect.
+
+namespace jnf {
+    namespace geometry {
+        namespace detail {
+            // Narrows [t0, t1] to the part of the segment on the inner side
+            // of one slab boundary, p * t <= q. A segment parallel to the
+            // boundary (p == 0) keeps its range if inside and gets an empty
+            // one otherwise. Branch-free, the selects become blends.
+            template <typename T>
+            inline void slab(const T p, const T q, T& t0, T& t1) {
+                const T t = q / (p == T(0) ? T(1) : p);
+                t0 = (p < T(0)) & (t > t0) ? t : t0;
+                t1 = (p > T(0)) & (t < t1) ? t : t1;
+                t1 = (p == T(0)) & (q < T(0)) ? T(-1) : t1;
+            }
+        }
+
+        // The part of the segment inside the rect, or nothing if they are
+        // disjoint. The clipped segment keeps the direction of l. The slab
+        // parameters are fractions, so T must be a floating point type.
+        template<typename T>
+        inline std::optional<line<T>> clip(const rect<T>& r,
+                const line<T>& l) {
+            static_assert(std::is_floating_point_v<T>);
+            const auto d = l.vec();
+            auto t0 = T(0);
+            auto t1 = T(1);
+            detail::slab(-d.x, l.start.x - r.pos.x, t0, t1);
+            detail::slab(d.x, r.pos.x + r.size.x - l.start.x, t0, t1);
+            detail::slab(-d.y, l.start.y - r.pos.y, t0, t1);
+            detail::slab(d.y, r.pos.y + r.size.y - l.start.y, t0, t1);
+            if (t0 > t1) {
+                return std::nullopt;
+            }
+            return line<T>(t0 == T(0) ? l.start : l.start + d * t0,
+                    t1 == T(1) ? l.end : l.start + d * t1);
+        }
+
+        // Batch form of clip(rect, line) over segments given as four
+        // coordinate arrays. The clipped segments are written to the output
+        // arrays and visible[i] is set to 1 if segment i reaches the rect, to
+        // 0 otherwise, in which case its outputs are unspecified. Outputs may
+        // alias the inputs element for element. Returns the number of
+        // visible segments.
+        template <typename T>
+        inline std::size_t clip(const rect<T>& r,
+                const std::span<const T> x0, const std::span<const T> y0,
+                const std::span<const T> x1, const std::span<const T> y1,
+                const std::span<T> cx0, const std::span<T> cy0,
+                const std::span<T> cx1, const std::span<T> cy1,
+                const std::span<std::uint8_t> visible) {
+            static_assert(std::is_floating_point_v<T>);
+            // Segments go through blocks staged in local arrays, so that
+            // each loop either reads the spans or writes one of them: the
+            // compiler then needs no runtime alias checks to vectorize, and
+            // the outputs may alias the inputs.
+            constexpr std::size_t block = 256;
+            const auto n = x0.size();
+            const T lx = r.pos.x;
+            const T ly = r.pos.y;
+            const T hx = r.pos.x + r.size.x;
+            const T hy = r.pos.y + r.size.y;
+            std::size_t count = 0;
+            T sx[block], sy[block], ex[block], ey[block];
+            T t0[block], t1[block];
+            for (std::size_t b = 0; b < n; b += block) {
+                const auto m = std::min(block, n - b);
+                std::copy_n(x0.data() + b, m, sx);
+                std::copy_n(y0.data() + b, m, sy);
+                std::copy_n(x1.data() + b, m, ex);
+                std::copy_n(y1.data() + b, m, ey);
+                for (std::size_t i = 0; i < m; ++i) {
+                    const T dx = ex[i] - sx[i];
+                    const T dy = ey[i] - sy[i];
+                    T lo = T(0);
+                    T hi = T(1);
+                    detail::slab(-dx, sx[i] - lx, lo, hi);
+                    detail::slab(dx, hx - sx[i], lo, hi);
+                    detail::slab(-dy, sy[i] - ly, lo, hi);
+                    detail::slab(dy, hy - sy[i], lo, hi);
+                    t0[i] = lo;
+                    t1[i] = hi;
+                }
+                std::uint8_t* vs = visible.data() + b;
+                for (std::size_t i = 0; i < m; ++i) {
+                    vs[i] = t0[i] <= t1[i];
+                    count += t0[i] <= t1[i];
+                }
+                // An end left in place is copied rather than recomputed, as
+                // start + (end - start) need not round back to end.
+                T* ox0 = cx0.data() + b;
+                T* oy0 = cy0.data() + b;
+                T* ox1 = cx1.data() + b;
+                T* oy1 = cy1.data() + b;
+                for (std::size_t i = 0; i < m; ++i) {
+                    ox0[i] = sx[i] + (ex[i] - sx[i]) * t0[i];
+                }
+                for (std::size_t i = 0; i < m; ++i) {
+                    oy0[i] = sy[i] + (ey[i] - sy[i]) * t0[i];
+                }
+                for (std::size_t i = 0; i < m; ++i) {
+                    ox1[i] = t1[i] == T(1) ? ex[i]
+                            : sx[i] + (ex[i] - sx[i]) * t1[i];
+                }
+                for (std::size_t i = 0; i < m; ++i) {
+                    oy1[i] = t1[i] == T(1) ? ey[i]
+                            : sy[i] + (ey[i] - sy[i]) * t1[i];
+                }
+            }
+            return count;
+        }
+
+        namespace detail {
+            // Appends to out the ring clipped to x >= c, x <= c (upper), or
+            // the same in y.
+            template <typename T>
+            inline void clip_half(const std::span<const vec2<T>> in,
+                    std::vector<vec2<T>>& out, const bool y, const bool upper,
+                    const T c) {
+                const auto inside = [=](const vec2<T>& p) {
+                    const auto v = y ? p.y : p.x;
+                    return upper ? v <= c : v >= c;
+                };
+                const auto cut = [=](const vec2<T>& a, const vec2<T>& b) {
+                    if (y) {
+                        const auto t = (c - a.y) / (b.y - a.y);
+                        return vec2<T>(a.x + (b.x - a.x) * t, c);
+                    }
+                    const auto t = (c - a.x) / (b.x - a.x);
+                    return vec2<T>(c, a.y + (b.y - a.y) * t);
+                };
+                auto prev = in.back();
+                auto was = inside(prev);
+                for (const auto& p : in) {
+                    const auto is = inside(p);
+                    if (is != was) {
+                        out.push_back(was ? cut(prev, p) : cut(p, prev));
+                    }
+                    if (is) {
+                        out.push_back(p);
+                    }
+                    prev = p;
+                    was = is;
+                }
+            }
+
+            // Clips ring i of in to the rect into a, using b as scratch.
+            // False if the ring vanishes: less than three vertices remain or
+            // they enclose no area, as when the ring only touches the rect.
+            // The area is taken relative to the first vertex, so vertices
+            // along one side of the rect give exactly zero.
+            template <typename T>
+            inline bool clip_ring(const rect<T>& r,
+                    const polygon_buffer<T>& in, const std::size_t i,
+                    std::vector<vec2<T>>& a, std::vector<vec2<T>>& b) {
+                const auto lo = r.pos;
+                const auto hi = r.pos + r.size;
+                b.clear();
+                for (auto k = in.ring_offsets[i]; k < in.ring_offsets[i + 1];
+                        ++k) {
+                    b.emplace_back(in.x[k], in.y[k]);
+                }
+                a.clear();
+                if (b.size() >= 3) {
+                    clip_half<T>(b, a, false, false, lo.x);
+                }
+                b.clear();
+                if (a.size() > 0) {
+                    clip_half<T>(a, b, false, true, hi.x);
+                }
+                a.clear();
+                if (b.size() > 0) {
+                    clip_half<T>(b, a, true, false, lo.y);
+                }
+                b.clear();
+                if (a.size() > 0) {
+                    clip_half<T>(a, b, true, true, hi.y);
+                }
+                a.swap(b);
+                if (a.size() < 3) {
+                    return false;
+                }
+                T area = T(0);
+                for (std::size_t k = 2; k < a.size(); ++k) {
+                    area += (a[k - 1] - a[0]).cross(a[k] - a[0]);
+                }
+                return area != T(0);
+            }
+
+            template <typename T>
+            inline void push_ring(polygon_buffer<T>& out,
+                    const std::vector<vec2<T>>& ring) {
+                for (const auto& p : ring) {
+                    out.push_vertex(p.x, p.y);
+                }
+                out.end_ring();
+            }
+
+            template <typename T>
+            inline rect<T> polygon_bounds(const polygon_buffer<T>& in,
+                    const std::size_t j) {
+                const auto ring = in.polygon_offsets[j];
+                if (ring == in.polygon_offsets[j + 1]
+                        || in.ring_offsets[ring] == in.ring_offsets[ring + 1]) {
+                    return rect<T>();
+                }
+                const auto first = in.ring_offsets[ring];
+                const auto last = in.ring_offsets[ring + 1];
+                vec2<T> lo(in.x[first], in.y[first]);
+                auto hi = lo;
+                for (auto k = first + 1; k < last; ++k) {
+                    lo = lo.min(vec2<T>(in.x[k], in.y[k]));
+                    hi = hi.max(vec2<T>(in.x[k], in.y[k]));
+                }
+                return rect<T>(lo, hi - lo);
+            }
+        }
+
+        // Clips polygon j of in to the rect and appends it to out under the
+        // same record. Every ring is clipped on its own; holes that vanish
+        // are dropped, and so is the polygon if its exterior ring does, in
+        // which case false is returned.
+        template <typename T>
+        inline bool clip(const rect<T>& r, const polygon_buffer<T>& in,
+                const std::size_t j, polygon_buffer<T>& out) {
+            const auto first = in.polygon_offsets[j];
+            const auto last = in.polygon_offsets[j + 1];
+            if (first == last) {
+                return false;
+            }
+            const auto lo = r.pos;
+            const auto hi = r.pos + r.size;
+            const auto box = detail::polygon_bounds(in, j);
+            const auto top = box.pos + box.size;
+            if (box.pos.x > hi.x || top.x < lo.x || box.pos.y > hi.y
+                    || top.y < lo.y) {
+                return false;
+            }
+            if (box.pos.x >= lo.x && top.x <= hi.x && box.pos.y >= lo.y
+                    && top.y <= hi.y) {
+                // Inside as a whole, holes included: copied as it is.
+                out.begin_polygon(in.record[j]);
+                for (auto i = first; i < last; ++i) {
+                    for (auto k = in.ring_offsets[i];
+                            k < in.ring_offsets[i + 1]; ++k) {
+                        out.push_vertex(in.x[k], in.y[k]);
+                    }
+                    out.end_ring();
+                }
+                out.end_polygon();
+                return true;
+            }
+            thread_local std::vector<vec2<T>> a;
+            thread_local std::vector<vec2<T>> b;
+            if (!detail::clip_ring(r, in, first, a, b)) {
+                return false;
+            }
+            out.begin_polygon(in.record[j]);
+            detail::push_ring(out, a);
+            for (auto i = first + 1; i < last; ++i) {
+                if (detail::clip_ring(r, in, i, a, b)) {
+                    detail::push_ring(out, a);
+                }
+            }
+            out.end_polygon();
+            return true;
+        }
+
+        // Clips every polygon of in to the rect into out, which is cleared
+        // first. Polygons that vanish are left out.
+        template <typename T>
+        inline void clip(const rect<T>& r, const polygon_buffer<T>& in,
+                polygon_buffer<T>& out) {
+            out.clear();
+            for (std::size_t j = 0; j < in.size(); ++j) {
+                clip(r, in, j, out);
+            }
+        }
+
+        // Clips the polygons of in to every tile: out[t] is cleared and
+        // receives the polygons reaching tiles[t], in the order of in.
+        // Candidates come from a Hilbert R-tree over the polygon bounds, and
+        // the tiles are handed out to the threads, each with its own
+        // scratch. threads = 0 uses every hardware thread.
+        template <typename T>
+        inline void clip_tiles(const polygon_buffer<T>& in,
+                const std::span<const rect<T>> tiles,
+                const std::span<polygon_buffer<T>> out,
+                const unsigned threads = 0) {
+            const auto workers = detail::workers(threads);
+            std::vector<rect<T>> boxes(in.size());
+            detail::parallel_for(workers, in.size(), 4096,
+                    [&](const std::size_t j) {
+                boxes[j] = detail::polygon_bounds(in, j);
+            });
+            hilbert_rtree<T> tree;
+            tree.build(std::span<const rect<T>>(boxes), workers);
+            detail::parallel_for(workers, tiles.size(), 1,
+                    [&](const std::size_t t) {
+                thread_local std::vector<std::uint32_t> found;
+                found.clear();
+                tree.query(tiles[t], [](const std::uint32_t j) {
+                    found.push_back(j);
+                });
+                std::sort(found.begin(), found.end());
+                out[t].clear();
+                for (const auto j : found) {
+                    clip(tiles[t], in, j, out[t]);
+                }
+            });
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_CLIP_H
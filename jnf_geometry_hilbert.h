@@ -0,0 +1,225 @@
+#ifndef JNF_GEOMETRY_HILBERT_H
+#define JNF_GEOMETRY_HILBERT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_morton.h"
+#include "jnf_geometry_parallel.h"
+
+// Hilbert curve ordering and a packed R-tree built on it. Unlike the Z-order
+// curve, the Hilbert curve never jumps: consecutive indices are neighbouring
+// cells, so runs of the order form compact regions even on skewed data. That
+// makes it a good order both for sending features out in spatially coherent
+// batches and for packing an R-tree bottom-up, where every node simply takes
+// the next node_size entries of the level below.
+
+namespace jnf {
+    namespace geometry {
+        // Position of (x, y) along the Hilbert curve over the 2^32 x 2^32
+        // grid, starting at the origin.
+        inline constexpr std::uint64_t hilbert(std::uint32_t x,
+                std::uint32_t y) {
+            std::uint64_t d = 0;
+            for (std::uint32_t s = 1u << 31; s > 0; s >>= 1) {
+                const std::uint32_t rx = (x & s) != 0;
+                const std::uint32_t ry = (y & s) != 0;
+                d += std::uint64_t(s) * s * ((3 * rx) ^ ry);
+                // Rotates the quadrant so the next level is traversed in the
+                // same orientation.
+                if (ry == 0) {
+                    if (rx == 1) {
+                        x = ~x;
+                        y = ~y;
+                    }
+                    std::swap(x, y);
+                }
+            }
+            return d;
+        }
+
+        // Hilbert index of p with bounds quantized to the 2^32 grid. Points
+        // outside the bounds are clamped to its border.
+        template <typename T>
+        inline std::uint64_t hilbert(const vec2<T>& p,
+                const rect<T>& bounds) {
+            const double q = 4294967295.0;
+            const auto cell = [q](const double v, const double lo,
+                    const double size) {
+                return static_cast<std::uint32_t>(size > 0
+                        ? std::clamp((v - lo) * (q / size), 0.0, q) : 0.0);
+            };
+            return hilbert(cell(p.x, bounds.pos.x, bounds.size.x),
+                    cell(p.y, bounds.pos.y, bounds.size.y));
+        }
+
+        // Indices of the shapes along the Hilbert curve through the key
+        // points (envelope_r centers for shapes other than vec2) over their
+        // bounds. Equal indices keep their input order. threads = 0 uses
+        // every hardware thread. The order and the scratch space of the
+        // sort are allocated with alloc.
+        template <typename S,
+                detail::allocator A = std::allocator<std::uint32_t>>
+        inline std::vector<std::uint32_t, A> hilbert_order(
+                const std::span<const S> shapes, const unsigned threads = 0,
+                const A& alloc = A()) {
+            using T = detail::scalar_t<S>;
+            using keys_alloc = typename std::allocator_traits<A>::
+                    template rebind_alloc<std::uint64_t>;
+            const auto workers = detail::workers(threads);
+            const auto bounds = detail::key_bounds<T>(shapes);
+            std::vector<std::uint64_t, keys_alloc> keys(shapes.size(),
+                    keys_alloc(alloc));
+            detail::parallel_for(workers, shapes.size(), 16384,
+                    [&](const std::size_t i) {
+                keys[i] = hilbert(detail::key_point(shapes[i]), bounds);
+            });
+            std::vector<std::uint32_t, A> order(shapes.size(), alloc);
+            for (std::size_t i = 0; i < order.size(); ++i) {
+                order[i] = static_cast<std::uint32_t>(i);
+            }
+            detail::radix_sort(keys, order, workers);
+            return order;
+        }
+
+        // Static R-tree packed bottom-up in Hilbert order. Every level is a
+        // contiguous run of boxes in one array, each node covering the next
+        // node_size entries of the level below, so the tree needs no child
+        // pointers and queries walk plain arrays.
+        template <typename T>
+        class hilbert_rtree {
+        public:
+            inline explicit hilbert_rtree(const std::size_t node_size = 16)
+                    : node_size_(std::max<std::size_t>(node_size, 2)) {
+            }
+
+            // Builds the tree over the envelope_r boxes of the shapes,
+            // replacing any previous contents. Leaf i refers to
+            // shapes[order()[i]].
+            template <typename S>
+            inline void build(const std::span<const S> shapes,
+                    const unsigned threads = 0) {
+                const auto workers = detail::workers(threads);
+                order_ = hilbert_order(shapes, workers);
+                const auto n = shapes.size();
+                levels_.assign(1, 0);
+                boxes_.resize(n);
+                detail::parallel_for(workers, n, 16384,
+                        [&](const std::size_t i) {
+                    boxes_[i] = envelope_r(shapes[order_[i]]);
+                });
+                auto count = n;
+                while (count > 1) {
+                    const auto from = levels_.back();
+                    const auto at = from + count;
+                    const auto parents = (count + node_size_ - 1) / node_size_;
+                    levels_.push_back(at);
+                    boxes_.resize(at + parents);
+                    detail::parallel_for(workers, parents, 1024,
+                            [&](const std::size_t j) {
+                        const auto b = from + j * node_size_;
+                        const auto e = std::min(b + node_size_, at);
+                        boxes_[at + j] = cover(b, e);
+                    });
+                    count = parents;
+                }
+                levels_.push_back(boxes_.size());
+            }
+
+            template <typename S>
+            inline void build(const std::vector<S>& shapes,
+                    const unsigned threads = 0) {
+                build(std::span<const S>(shapes), threads);
+            }
+
+            // Calls f(id) for every shape whose box meets the query box, edges
+            // included, id being its index in the array the tree was built
+            // from. If f returns bool, returning false stops the query.
+            template <typename F>
+            inline void query(const rect<T>& box, F&& f) const {
+                if (boxes_.empty()) {
+                    return;
+                }
+                std::vector<std::pair<std::size_t, std::size_t>> stack;
+                stack.emplace_back(levels_.size() - 2, boxes_.size() - 1);
+                while (!stack.empty()) {
+                    const auto [level, i] = stack.back();
+                    stack.pop_back();
+                    if (!detail::meets(boxes_[i], box)) {
+                        continue;
+                    }
+                    if (level == 0) {
+                        if constexpr (std::is_void_v<std::invoke_result_t<
+                                F&, std::uint32_t>>) {
+                            f(order_[i]);
+                        } else if (!f(order_[i])) {
+                            return;
+                        }
+                        continue;
+                    }
+                    const auto from = levels_[level - 1];
+                    const auto b = from + (i - levels_[level]) * node_size_;
+                    const auto e = std::min(b + node_size_, levels_[level]);
+                    for (auto c = e; c > b; --c) {
+                        stack.emplace_back(level - 1, c - 1);
+                    }
+                }
+            }
+
+            template <typename S, typename F>
+            inline void query(const S& shape, F&& f) const {
+                query(envelope_r(shape), f);
+            }
+
+            // Shape indices in Hilbert order, for streaming the features in
+            // spatially coherent batches.
+            inline std::span<const std::uint32_t> order() const {
+                return order_;
+            }
+
+            inline std::size_t size() const {
+                return order_.size();
+            }
+
+            inline std::size_t node_size() const {
+                return node_size_;
+            }
+
+            inline std::int32_t height() const {
+                return boxes_.empty() ? 0
+                        : static_cast<std::int32_t>(levels_.size()) - 1;
+            }
+
+            inline rect<T> bounds() const {
+                return boxes_.empty() ? rect<T>() : boxes_.back();
+            }
+
+        private:
+            std::size_t node_size_;
+            std::vector<rect<T>> boxes_;
+            std::vector<std::size_t> levels_;
+            std::vector<std::uint32_t> order_;
+
+            inline rect<T> cover(const std::size_t b,
+                    const std::size_t e) const {
+                auto lo = boxes_[b].pos;
+                auto hi = boxes_[b].pos + boxes_[b].size;
+                for (auto i = b + 1; i < e; ++i) {
+                    lo = lo.min(boxes_[i].pos);
+                    hi = hi.max(boxes_[i].pos + boxes_[i].size);
+                }
+                return rect<T>(lo, hi - lo);
+            }
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_HILBERT_H
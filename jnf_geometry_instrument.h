@@ -0,0 +1,368 @@
+#ifndef JNF_GEOMETRY_INSTRUMENT_H
+#define JNF_GEOMETRY_INSTRUMENT_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Per-overload counters for the predicates in jnf_geometry.h. Only included
+// when JNF_GEOMETRY_INSTRUMENT is defined; otherwise every probe expands to
+// nothing. Defining JNF_GEOMETRY_INSTRUMENT_TIMING additionally records the
+// inclusive wall time spent in each overload.
+//
+// Only the outermost probed call on a thread is counted: the predicates an
+// overload runs on its own behalf, forwarding to the mirrored overload or
+// testing sides one by one, are part of its cost and are not recorded again.
+// Predicates called from a visitor while intersects runs are skipped alike.
+
+namespace jnf {
+    template <typename T>
+    struct vec2;
+
+    namespace geometry {
+        template <typename T>
+        struct line;
+
+        template <typename T>
+        struct rect;
+
+        template <typename T>
+        struct circle;
+
+        template <typename T>
+        struct obb;
+
+        template <typename T>
+        struct capsule;
+
+        namespace instrument {
+            enum class op : std::uint8_t {
+                contains,
+                overlaps,
+                intersects,
+                closest,
+                count
+            };
+
+            enum class shape : std::uint8_t {
+                vec2,
+                line,
+                rect,
+                circle,
+                obb,
+                capsule,
+                count
+            };
+
+            inline constexpr std::string_view name(const op o) {
+                constexpr std::string_view names[] = {
+                    "contains", "overlaps", "intersects", "closest"
+                };
+                return names[static_cast<std::size_t>(o)];
+            }
+
+            inline constexpr std::string_view name(const shape s) {
+                constexpr std::string_view names[] = {
+                    "vec2", "line", "rect", "circle", "obb",
+                    "capsule"
+                };
+                return names[static_cast<std::size_t>(s)];
+            }
+
+            template <typename S>
+            struct shape_of;
+
+            template <typename T>
+            struct shape_of<vec2<T>> {
+                static constexpr shape value = shape::vec2;
+            };
+
+            template <typename T>
+            struct shape_of<line<T>> {
+                static constexpr shape value = shape::line;
+            };
+
+            template <typename T>
+            struct shape_of<rect<T>> {
+                static constexpr shape value = shape::rect;
+            };
+
+            template <typename T>
+            struct shape_of<circle<T>> {
+                static constexpr shape value = shape::circle;
+            };
+
+            template <typename T>
+            struct shape_of<obb<T>> {
+                static constexpr shape value = shape::obb;
+            };
+
+            template <typename T>
+            struct shape_of<capsule<T>> {
+                static constexpr shape value = shape::capsule;
+            };
+
+            template <typename S>
+            inline constexpr shape shape_of_v =
+                    shape_of<std::remove_cvref_t<S>>::value;
+
+            constexpr std::size_t ops = static_cast<std::size_t>(op::count);
+            constexpr std::size_t shapes =
+                    static_cast<std::size_t>(shape::count);
+            constexpr std::size_t slots = ops * shapes * shapes;
+
+            inline constexpr std::size_t index(const op o, const shape a,
+                    const shape b) {
+                return (static_cast<std::size_t>(o) * shapes
+                        + static_cast<std::size_t>(a)) * shapes
+                        + static_cast<std::size_t>(b);
+            }
+
+            struct counters {
+                std::uint64_t calls = 0;
+                std::uint64_t hits = 0;
+                std::uint64_t rejects = 0;
+                std::uint64_t nanoseconds = 0;
+
+                inline counters& operator+=(const counters& c) {
+                    calls += c.calls;
+                    hits += c.hits;
+                    rejects += c.rejects;
+                    nanoseconds += c.nanoseconds;
+                    return *this;
+                }
+            };
+
+            struct snapshot {
+                std::array<counters, slots> entries{};
+
+                inline const counters& at(const op o, const shape a,
+                        const shape b) const {
+                    return entries[index(o, a, b)];
+                }
+
+                // Calls f(op, shape, shape, counters) for every overload that
+                // was called at least once.
+                template <typename F>
+                inline void for_each(F&& f) const {
+                    for (std::size_t i = 0; i < entries.size(); ++i) {
+                        if (entries[i].calls == 0) {
+                            continue;
+                        }
+                        f(static_cast<op>(i / (shapes * shapes)),
+                                static_cast<shape>(i / shapes % shapes),
+                                static_cast<shape>(i % shapes), entries[i]);
+                    }
+                }
+
+                inline std::string csv() const {
+                    std::string s = "op,a,b,calls,hits,rejects,nanoseconds\n";
+                    for_each([&s](const op o, const shape a, const shape b,
+                            const counters& c) {
+                        s.append(name(o)).append(",").append(name(a))
+                                .append(",").append(name(b)).append(",")
+                                .append(std::to_string(c.calls)).append(",")
+                                .append(std::to_string(c.hits)).append(",")
+                                .append(std::to_string(c.rejects))
+                                .append(",")
+                                .append(std::to_string(c.nanoseconds))
+                                .append("\n");
+                    });
+                    return s;
+                }
+            };
+
+            namespace detail {
+                // Counters are only ever written by their owning thread, so a
+                // relaxed load/store pair suffices and no locked instruction
+                // is issued on the hot path; the atomics merely make
+                // concurrent snapshots well defined.
+                struct cell {
+                    std::atomic<std::uint64_t> calls{0};
+                    std::atomic<std::uint64_t> hits{0};
+                    std::atomic<std::uint64_t> rejects{0};
+                    std::atomic<std::uint64_t> nanoseconds{0};
+
+                    static inline void add(std::atomic<std::uint64_t>& a,
+                            const std::uint64_t n) {
+                        a.store(a.load(std::memory_order_relaxed) + n,
+                                std::memory_order_relaxed);
+                    }
+
+                    inline counters load() const {
+                        counters c;
+                        c.calls = calls.load(std::memory_order_relaxed);
+                        c.hits = hits.load(std::memory_order_relaxed);
+                        c.rejects = rejects.load(std::memory_order_relaxed);
+                        c.nanoseconds =
+                                nanoseconds.load(std::memory_order_relaxed);
+                        return c;
+                    }
+
+                    inline void reset() {
+                        calls.store(0, std::memory_order_relaxed);
+                        hits.store(0, std::memory_order_relaxed);
+                        rejects.store(0, std::memory_order_relaxed);
+                        nanoseconds.store(0, std::memory_order_relaxed);
+                    }
+                };
+
+                struct table {
+                    std::array<cell, slots> cells;
+                    // Probes currently open on the owning thread.
+                    std::uint32_t depth = 0;
+                };
+
+                // Keeps track of every thread's table so snapshots can sum
+                // them, and folds the tables of exited threads into a total.
+                struct registry {
+                    std::mutex mutex;
+                    std::vector<table*> live;
+                    snapshot retired;
+
+                    static inline registry& get() {
+                        static registry r;
+                        return r;
+                    }
+                };
+
+                struct thread_table : table {
+                    inline thread_table() {
+                        auto& r = registry::get();
+                        std::lock_guard<std::mutex> lock(r.mutex);
+                        r.live.push_back(this);
+                    }
+
+                    inline ~thread_table() {
+                        auto& r = registry::get();
+                        std::lock_guard<std::mutex> lock(r.mutex);
+                        for (std::size_t i = 0; i < slots; ++i) {
+                            r.retired.entries[i] += cells[i].load();
+                        }
+                        std::erase(r.live, this);
+                    }
+                };
+
+                inline table& local() {
+                    thread_local thread_table t;
+                    return t;
+                }
+            }
+
+            // Counters of the calling thread only.
+            inline snapshot local() {
+                snapshot s;
+                const auto& t = detail::local();
+                for (std::size_t i = 0; i < slots; ++i) {
+                    s.entries[i] = t.cells[i].load();
+                }
+                return s;
+            }
+
+            // Counters summed over all threads, including exited ones.
+            inline snapshot global() {
+                auto& r = detail::registry::get();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                snapshot s = r.retired;
+                for (const auto* t : r.live) {
+                    for (std::size_t i = 0; i < slots; ++i) {
+                        s.entries[i] += t->cells[i].load();
+                    }
+                }
+                return s;
+            }
+
+            inline void reset() {
+                auto& r = detail::registry::get();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                r.retired = snapshot();
+                for (auto* t : r.live) {
+                    for (auto& c : t->cells) {
+                        c.reset();
+                    }
+                }
+            }
+
+            // Scoped recorder placed at the top of every instrumented
+            // overload. It is a literal type so that the constexpr predicates
+            // stay usable in constant expressions, where it does nothing.
+            class probe {
+            public:
+                inline constexpr probe(const op o, const shape a,
+                        const shape b) : index_(index(o, a, b)) {
+                    if (std::is_constant_evaluated()) {
+                        return;
+                    }
+                    outer_ = detail::local().depth++ == 0;
+#ifdef JNF_GEOMETRY_INSTRUMENT_TIMING
+                    if (outer_) {
+                        start_ = std::chrono::steady_clock::now();
+                    }
+#endif
+                }
+
+                probe(const probe&) = delete;
+
+                probe& operator=(const probe&) = delete;
+
+                inline constexpr ~probe() {
+                    if (std::is_constant_evaluated()) {
+                        return;
+                    }
+                    auto& thread = detail::local();
+                    --thread.depth;
+                    if (!outer_) {
+                        return;
+                    }
+                    auto& c = thread.cells[index_];
+                    detail::cell::add(c.calls, 1);
+                    detail::cell::add(c.hits, hit_);
+                    detail::cell::add(c.rejects, reject_);
+#ifdef JNF_GEOMETRY_INSTRUMENT_TIMING
+                    const auto t = std::chrono::duration_cast<
+                            std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start_);
+                    detail::cell::add(c.nanoseconds,
+                            static_cast<std::uint64_t>(t.count()));
+#endif
+                }
+
+                inline constexpr bool result(const bool b) {
+                    hit_ = b;
+                    return b;
+                }
+
+                inline constexpr void reject() {
+                    reject_ = true;
+                }
+
+            private:
+                std::size_t index_;
+                bool outer_ = false;
+                bool hit_ = false;
+                bool reject_ = false;
+#ifdef JNF_GEOMETRY_INSTRUMENT_TIMING
+                std::chrono::steady_clock::time_point start_;
+#endif
+            };
+        }
+    }
+}
+
+#define JNF_GEOMETRY_PROBE(o, a, b) \
+    ::jnf::geometry::instrument::probe jnf_probe_( \
+            ::jnf::geometry::instrument::op::o, \
+            ::jnf::geometry::instrument::shape_of_v<decltype(a)>, \
+            ::jnf::geometry::instrument::shape_of_v<decltype(b)>)
+#define JNF_GEOMETRY_RESULT(x) jnf_probe_.result(x)
+#define JNF_GEOMETRY_HIT(x) jnf_probe_.result(x)
+#define JNF_GEOMETRY_REJECT() jnf_probe_.reject()
+
+#endif // JNF_GEOMETRY_INSTRUMENT_H
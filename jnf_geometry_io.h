@@ -0,0 +1,1090 @@
+#ifndef JNF_GEOMETRY_IO_H
+#define JNF_GEOMETRY_IO_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "jnf_geometry.h"
+
+namespace jnf {
+    namespace geometry {
+        // Struct-of-arrays sinks filled by the streaming readers. Every entry
+        // carries the index of the input record it came from so that multi
+        // geometries and collections can be regrouped by the caller. Buffers
+        // only ever grow, so clearing them between chunks keeps their
+        // capacity and the steady state performs no allocations.
+        template <typename T>
+        struct point_buffer {
+            std::vector<T> x;
+            std::vector<T> y;
+            std::vector<std::uint64_t> record;
+
+            inline std::size_t size() const {
+                return record.size();
+            }
+
+            inline vec2<T> operator[](const std::size_t i) const {
+                return vec2<T>(x[i], y[i]);
+            }
+
+            inline void push_back(const T px, const T py,
+                    const std::uint64_t rec) {
+                x.push_back(px);
+                y.push_back(py);
+                record.push_back(rec);
+            }
+
+            inline void resize(const std::size_t n) {
+                x.resize(n);
+                y.resize(n);
+                record.resize(n);
+            }
+
+            inline void clear() {
+                resize(0);
+            }
+        };
+
+        template <typename T>
+        struct line_buffer {
+            std::vector<T> x0;
+            std::vector<T> y0;
+            std::vector<T> x1;
+            std::vector<T> y1;
+            std::vector<std::uint64_t> record;
+
+            inline std::size_t size() const {
+                return record.size();
+            }
+
+            inline line<T> operator[](const std::size_t i) const {
+                return line<T>(vec2<T>(x0[i], y0[i]), vec2<T>(x1[i], y1[i]));
+            }
+
+            inline void push_back(const T ax, const T ay, const T bx,
+                    const T by, const std::uint64_t rec) {
+                x0.push_back(ax);
+                y0.push_back(ay);
+                x1.push_back(bx);
+                y1.push_back(by);
+                record.push_back(rec);
+            }
+
+            inline void resize(const std::size_t n) {
+                x0.resize(n);
+                y0.resize(n);
+                x1.resize(n);
+                y1.resize(n);
+                record.resize(n);
+            }
+
+            inline void clear() {
+                resize(0);
+            }
+        };
+
+        template <typename T>
+        struct rect_buffer {
+            std::vector<T> x;
+            std::vector<T> y;
+            std::vector<T> w;
+            std::vector<T> h;
+            std::vector<std::uint64_t> record;
+
+            inline std::size_t size() const {
+                return record.size();
+            }
+
+            inline rect<T> operator[](const std::size_t i) const {
+                return rect<T>(vec2<T>(x[i], y[i]), vec2<T>(w[i], h[i]));
+            }
+
+            inline void push_back(const T px, const T py, const T sx,
+                    const T sy, const std::uint64_t rec) {
+                x.push_back(px);
+                y.push_back(py);
+                w.push_back(sx);
+                h.push_back(sy);
+                record.push_back(rec);
+            }
+
+            inline void resize(const std::size_t n) {
+                x.resize(n);
+                y.resize(n);
+                w.resize(n);
+                h.resize(n);
+                record.resize(n);
+            }
+
+            inline void clear() {
+                resize(0);
+            }
+        };
+
+        template <typename T>
+        struct circle_buffer {
+            std::vector<T> x;
+            std::vector<T> y;
+            std::vector<T> r;
+            std::vector<std::uint64_t> record;
+
+            inline std::size_t size() const {
+                return record.size();
+            }
+
+            inline circle<T> operator[](const std::size_t i) const {
+                return circle<T>(vec2<T>(x[i], y[i]), r[i]);
+            }
+
+            inline void push_back(const T cx, const T cy, const T cr,
+                    const std::uint64_t rec) {
+                x.push_back(cx);
+                y.push_back(cy);
+                r.push_back(cr);
+                record.push_back(rec);
+            }
+
+            inline void resize(const std::size_t n) {
+                x.resize(n);
+                y.resize(n);
+                r.resize(n);
+                record.resize(n);
+            }
+
+            inline void clear() {
+                resize(0);
+            }
+        };
+
+        // Polygons are stored in compressed form: the vertices of ring i are
+        // x/y[ring_offsets[i], ring_offsets[i + 1]) and the rings of polygon j
+        // are [polygon_offsets[j], polygon_offsets[j + 1]), the first one
+        // being the exterior ring. Both offset arrays hold a trailing end
+        // marker, so they are never empty.
+        template <typename T>
+        struct polygon_buffer {
+            std::vector<T> x;
+            std::vector<T> y;
+            std::vector<std::uint32_t> ring_offsets = {0};
+            std::vector<std::uint32_t> polygon_offsets = {0};
+            std::vector<std::uint64_t> record;
+
+            inline std::size_t size() const {
+                return record.size();
+            }
+
+            inline std::size_t rings() const {
+                return ring_offsets.size() - 1;
+            }
+
+            inline void begin_polygon(const std::uint64_t rec) {
+                record.push_back(rec);
+            }
+
+            inline void push_vertex(const T px, const T py) {
+                x.push_back(px);
+                y.push_back(py);
+            }
+
+            inline void end_ring() {
+                ring_offsets.push_back(static_cast<std::uint32_t>(x.size()));
+            }
+
+            inline void end_polygon() {
+                polygon_offsets.push_back(
+                        static_cast<std::uint32_t>(rings()));
+            }
+
+            inline void clear() {
+                x.clear();
+                y.clear();
+                ring_offsets.resize(1);
+                polygon_offsets.resize(1);
+                record.clear();
+            }
+        };
+
+        template <typename T>
+        struct shape_buffers {
+            point_buffer<T> points;
+            line_buffer<T> lines;
+            rect_buffer<T> rects;
+            circle_buffer<T> circles;
+            polygon_buffer<T> polygons;
+
+            inline void clear() {
+                points.clear();
+                lines.clear();
+                rects.clear();
+                circles.clear();
+                polygons.clear();
+            }
+        };
+
+        namespace detail {
+            // Buffer sizes at the start of a record, used to drop everything
+            // a malformed record emitted before the error was detected.
+            struct shape_marks {
+                std::size_t points;
+                std::size_t lines;
+                std::size_t rects;
+                std::size_t circles;
+                std::size_t polygons;
+                std::size_t vertices;
+                std::size_t rings;
+                std::size_t polygon_rings;
+
+                template <typename T>
+                inline explicit shape_marks(const shape_buffers<T>& b)
+                        : points(b.points.size()), lines(b.lines.size()),
+                        rects(b.rects.size()), circles(b.circles.size()),
+                        polygons(b.polygons.size()),
+                        vertices(b.polygons.x.size()),
+                        rings(b.polygons.ring_offsets.size()),
+                        polygon_rings(b.polygons.polygon_offsets.size()) {
+                }
+
+                template <typename T>
+                inline void rollback(shape_buffers<T>& b) const {
+                    b.points.resize(points);
+                    b.lines.resize(lines);
+                    b.rects.resize(rects);
+                    b.circles.resize(circles);
+                    b.polygons.record.resize(polygons);
+                    b.polygons.x.resize(vertices);
+                    b.polygons.y.resize(vertices);
+                    b.polygons.ring_offsets.resize(rings);
+                    b.polygons.polygon_offsets.resize(polygon_rings);
+                }
+            };
+
+            struct cursor {
+                const char* p;
+                const char* end;
+
+                inline bool done() const {
+                    return p == end;
+                }
+
+                inline void skip_ws() {
+                    while (p != end && (*p == ' ' || *p == '\t' || *p == '\n'
+                            || *p == '\r' || *p == '\x1e')) {
+                        ++p;
+                    }
+                }
+
+                inline bool peek(const char c) {
+                    skip_ws();
+                    return p != end && *p == c;
+                }
+
+                inline bool accept(const char c) {
+                    if (peek(c)) {
+                        ++p;
+                        return true;
+                    }
+                    return false;
+                }
+
+                // Case-insensitive keyword match that must not be followed by
+                // another identifier character.
+                inline bool keyword(const std::string_view k) {
+                    skip_ws();
+                    if (static_cast<std::size_t>(end - p) < k.size()) {
+                        return false;
+                    }
+                    for (std::size_t i = 0; i < k.size(); ++i) {
+                        if ((p[i] | 0x20) != (k[i] | 0x20)) {
+                            return false;
+                        }
+                    }
+                    const char* q = p + k.size();
+                    if (q != end && (((*q | 0x20) >= 'a' && (*q | 0x20) <= 'z')
+                            || *q == '_')) {
+                        return false;
+                    }
+                    p = q;
+                    return true;
+                }
+
+                template <typename T>
+                inline bool number(T& out) {
+                    skip_ws();
+                    if (p != end && *p == '+') {
+                        ++p;
+                    }
+                    if constexpr (std::is_floating_point_v<T>) {
+                        const auto r = std::from_chars(p, end, out);
+                        if (r.ec != std::errc()) {
+                            return false;
+                        }
+                        p = r.ptr;
+                    } else {
+                        double d;
+                        const auto r = std::from_chars(p, end, d);
+                        if (r.ec != std::errc()) {
+                            return false;
+                        }
+                        p = r.ptr;
+                        out = static_cast<T>(d);
+                    }
+                    return true;
+                }
+            };
+
+            inline bool iequals(const std::string_view a,
+                    const std::string_view b) {
+                if (a.size() != b.size()) {
+                    return false;
+                }
+                for (std::size_t i = 0; i < a.size(); ++i) {
+                    if ((a[i] | 0x20) != (b[i] | 0x20)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Carries a partial record across chunk boundaries. Complete
+            // records are handed out as views straight into the caller's chunk;
+            // only the bytes of a record that straddles two chunks are copied.
+            template <typename Split>
+            class record_stream {
+            public:
+                template <typename F>
+                inline void feed(const std::string_view chunk, F&& f) {
+                    std::size_t from = 0;
+                    if (!pending_.empty()) {
+                        const auto n = split_.find_end(chunk);
+                        if (n == std::string_view::npos) {
+                            pending_.append(chunk);
+                            return;
+                        }
+                        pending_.append(chunk.substr(0, n));
+                        f(std::string_view(pending_));
+                        pending_.clear();
+                        from = n;
+                    }
+                    while (from < chunk.size()) {
+                        const auto rest = chunk.substr(from);
+                        const auto n = split_.find_end(rest);
+                        if (n == std::string_view::npos) {
+                            pending_.assign(rest);
+                            return;
+                        }
+                        f(rest.substr(0, n));
+                        from += n;
+                    }
+                }
+
+                // Hands out the bytes left after the last complete record,
+                // after telling the splitter that the input ended there.
+                template <typename F>
+                inline void finish(F&& f) {
+                    if (!pending_.empty()) {
+                        split_.finish();
+                        f(std::string_view(pending_));
+                        pending_.clear();
+                    }
+                    split_ = Split();
+                }
+
+                // The splitter, whose state describes the record last
+                // handed out.
+                inline const Split& split() const {
+                    return split_;
+                }
+
+            private:
+                std::string pending_;
+                Split split_;
+            };
+
+            // WKT records are newline delimited.
+            struct line_split {
+                inline std::size_t find_end(const std::string_view s) {
+                    const auto n = s.find('\n');
+                    return n == std::string_view::npos ? n : n + 1;
+                }
+
+                // A last line without a newline is complete.
+                inline void finish() {
+                }
+            };
+
+            // GeoJSON records end where a top-level value closes, which covers
+            // newline-delimited GeoJSON, RFC 8142 text sequences and
+            // pretty-printed documents alike. The "features" array of a
+            // top-level object is split further, one record per element, so
+            // that a FeatureCollection streams feature by feature instead of
+            // being buffered whole: the collection comes out as a head up to
+            // the opening bracket, one part per feature (with its leading
+            // separator) and a tail. part tells which one the last record
+            // was, or that it was cut off by the end of the input. The
+            // scanner state survives across chunks.
+            struct json_split {
+                enum class kind : std::uint8_t {
+                    value,
+                    head,
+                    feature,
+                    tail,
+                    truncated
+                };
+
+                kind part = kind::value;
+                std::int32_t depth = 0;
+                bool string = false;
+                bool escape = false;
+                // Scan of the member names of the top-level object.
+                std::uint8_t key = 0;
+                bool features_key = false;
+                bool features_next = false;
+                bool in_features = false;
+                bool split = false;
+
+                inline std::size_t find_end(const std::string_view s) {
+                    constexpr std::string_view features = "features";
+                    for (std::size_t i = 0; i < s.size(); ++i) {
+                        const char c = s[i];
+                        if (string) {
+                            if (escape) {
+                                escape = false;
+                            } else if (c == '\\') {
+                                escape = true;
+                                key = features.size() + 1;
+                            } else if (c == '"') {
+                                string = false;
+                                features_key = depth == 1
+                                        && key == features.size();
+                            } else if (depth == 1) {
+                                key = key < features.size()
+                                        && c == features[key] ? key + 1
+                                        : features.size() + 1;
+                            }
+                            continue;
+                        }
+                        if (depth == 1 && c != ' ' && c != '\t' && c != '\n'
+                                && c != '\r') {
+                            const bool next = c == ':' && features_key;
+                            if (c == '[' && features_next) {
+                                ++depth;
+                                in_features = true;
+                                split = true;
+                                features_next = false;
+                                part = kind::head;
+                                return i + 1;
+                            }
+                            features_next = next;
+                            features_key = false;
+                        }
+                        if (c == '"') {
+                            string = true;
+                            key = 0;
+                        } else if (c == '{' || c == '[') {
+                            ++depth;
+                        } else if (c == '}' || c == ']') {
+                            --depth;
+                            if (in_features && depth == 2) {
+                                part = kind::feature;
+                                return i + 1;
+                            }
+                            if (depth == 1) {
+                                in_features = false;
+                            } else if (depth == 0) {
+                                part = split ? kind::tail : kind::value;
+                                split = false;
+                                return i + 1;
+                            }
+                        }
+                    }
+                    return std::string_view::npos;
+                }
+
+                // The input ended: the pending bytes are a value of their own
+                // if no bracket or string is open, else a truncated record.
+                inline void finish() {
+                    part = depth == 0 && !string ? kind::value
+                            : kind::truncated;
+                }
+            };
+        }
+
+        // Streaming WKT reader. Input is fed in arbitrary chunks holding one
+        // geometry per line; every complete record is parsed in place and
+        // appended to the sink. Z and M ordinates are accepted and dropped.
+        // Besides the OGC types, the BBOX(minx, maxx, maxy, miny) envelope
+        // extension is read as a rect and CIRCLE(x y r) as a circle. Line
+        // strings are emitted as one line per segment, polygons and
+        // multipolygons as polygon records. Malformed records are skipped
+        // and counted.
+        template <typename T>
+        class wkt_reader {
+        public:
+            inline explicit wkt_reader(shape_buffers<T>& out) : out_(&out) {
+            }
+
+            inline void feed(const std::string_view chunk) {
+                stream_.feed(chunk, [this](const std::string_view r) {
+                    parse_record(r);
+                });
+            }
+
+            inline void finish() {
+                stream_.finish([this](const std::string_view r) {
+                    parse_record(r);
+                });
+            }
+
+            inline std::uint64_t records() const {
+                return record_;
+            }
+
+            inline std::uint64_t malformed() const {
+                return malformed_;
+            }
+
+        private:
+            shape_buffers<T>* out_;
+            detail::record_stream<detail::line_split> stream_;
+            std::uint64_t record_ = 0;
+            std::uint64_t malformed_ = 0;
+
+            inline void parse_record(const std::string_view r) {
+                detail::cursor c{r.data(), r.data() + r.size()};
+                c.skip_ws();
+                if (c.done()) {
+                    return;
+                }
+                const detail::shape_marks marks(*out_);
+                if (c.keyword("SRID")) {
+                    while (!c.done() && *c.p != ';') {
+                        ++c.p;
+                    }
+                    c.accept(';');
+                }
+                if (geometry(c)) {
+                    c.accept(';');
+                    c.skip_ws();
+                    if (c.done()) {
+                        ++record_;
+                        return;
+                    }
+                }
+                marks.rollback(*out_);
+                ++malformed_;
+                ++record_;
+            }
+
+            inline bool dimension(detail::cursor& c) {
+                if (!c.keyword("ZM") && !c.keyword("Z")) {
+                    c.keyword("M");
+                }
+                return true;
+            }
+
+            inline bool coord(detail::cursor& c, T& x, T& y) {
+                if (!c.number(x) || !c.number(y)) {
+                    return false;
+                }
+                T skip;
+                while (!c.peek(',') && !c.peek(')') && c.number(skip)) {
+                }
+                return true;
+            }
+
+            inline bool point(detail::cursor& c) {
+                T x;
+                T y;
+                const bool wrapped = c.accept('(');
+                if (!coord(c, x, y) || (wrapped && !c.accept(')'))) {
+                    return false;
+                }
+                out_->points.push_back(x, y, record_);
+                return true;
+            }
+
+            inline bool linestring(detail::cursor& c) {
+                T x0;
+                T y0;
+                if (!c.accept('(') || !coord(c, x0, y0)) {
+                    return false;
+                }
+                while (c.accept(',')) {
+                    T x1;
+                    T y1;
+                    if (!coord(c, x1, y1)) {
+                        return false;
+                    }
+                    out_->lines.push_back(x0, y0, x1, y1, record_);
+                    x0 = x1;
+                    y0 = y1;
+                }
+                return c.accept(')');
+            }
+
+            inline bool polygon(detail::cursor& c) {
+                if (!c.accept('(')) {
+                    return false;
+                }
+                auto& p = out_->polygons;
+                p.begin_polygon(record_);
+                do {
+                    if (!c.accept('(')) {
+                        return false;
+                    }
+                    do {
+                        T x;
+                        T y;
+                        if (!coord(c, x, y)) {
+                            return false;
+                        }
+                        p.push_vertex(x, y);
+                    } while (c.accept(','));
+                    if (!c.accept(')')) {
+                        return false;
+                    }
+                    p.end_ring();
+                } while (c.accept(','));
+                p.end_polygon();
+                return c.accept(')');
+            }
+
+            template <typename F>
+            inline bool list(detail::cursor& c, F&& f) {
+                if (c.keyword("EMPTY")) {
+                    return true;
+                }
+                if (!c.accept('(')) {
+                    return false;
+                }
+                do {
+                    if (!c.keyword("EMPTY") && !f(c)) {
+                        return false;
+                    }
+                } while (c.accept(','));
+                return c.accept(')');
+            }
+
+            inline bool geometry(detail::cursor& c) {
+                if (c.keyword("POINT")) {
+                    dimension(c);
+                    if (c.keyword("EMPTY")) {
+                        return true;
+                    }
+                    return c.peek('(') && point(c);
+                }
+                if (c.keyword("LINESTRING")) {
+                    dimension(c);
+                    return c.keyword("EMPTY") || linestring(c);
+                }
+                if (c.keyword("POLYGON")) {
+                    dimension(c);
+                    return c.keyword("EMPTY") || polygon(c);
+                }
+                if (c.keyword("MULTIPOINT")) {
+                    dimension(c);
+                    return list(c, [this](detail::cursor& c) {
+                        return point(c);
+                    });
+                }
+                if (c.keyword("MULTILINESTRING")) {
+                    dimension(c);
+                    return list(c, [this](detail::cursor& c) {
+                        return linestring(c);
+                    });
+                }
+                if (c.keyword("MULTIPOLYGON")) {
+                    dimension(c);
+                    return list(c, [this](detail::cursor& c) {
+                        return polygon(c);
+                    });
+                }
+                if (c.keyword("GEOMETRYCOLLECTION")) {
+                    dimension(c);
+                    return list(c, [this](detail::cursor& c) {
+                        return geometry(c);
+                    });
+                }
+                if (c.keyword("BBOX") || c.keyword("ENVELOPE")) {
+                    T x0;
+                    T x1;
+                    T y1;
+                    T y0;
+                    if (!c.accept('(') || !c.number(x0) || !c.accept(',')
+                            || !c.number(x1) || !c.accept(',')
+                            || !c.number(y1) || !c.accept(',')
+                            || !c.number(y0) || !c.accept(')')) {
+                        return false;
+                    }
+                    out_->rects.push_back(x0, y0, x1 - x0, y1 - y0, record_);
+                    return true;
+                }
+                if (c.keyword("CIRCLE")) {
+                    T x;
+                    T y;
+                    T r;
+                    if (!c.accept('(') || !c.number(x) || !c.number(y)) {
+                        return false;
+                    }
+                    c.accept(',');
+                    if (!c.number(r) || !c.accept(')')) {
+                        return false;
+                    }
+                    out_->circles.push_back(x, y, r, record_);
+                    return true;
+                }
+                return false;
+            }
+        };
+
+        // Streaming GeoJSON reader. Accepts a sequence of GeoJSON values fed
+        // in arbitrary chunks: geometries, Features and FeatureCollections.
+        // Every feature of a top-level FeatureCollection is a record of its
+        // own, parsed as soon as it is complete, so memory stays bounded by
+        // the largest feature and a malformed feature only loses itself.
+        // Input that ends inside a value counts as one malformed record.
+        // Members other than those describing geometry are skipped without
+        // being materialised, and since member order is free the coordinates
+        // are only remembered as a position and parsed once the type is
+        // known. The "envelope" ([[minx, maxy], [maxx, miny]]) and "circle"
+        // (centre plus a numeric "radius" member) extension types are read as
+        // rects and circles, everything else maps as in wkt_reader.
+        template <typename T>
+        class geojson_reader {
+        public:
+            inline explicit geojson_reader(shape_buffers<T>& out)
+                    : out_(&out) {
+            }
+
+            inline void feed(const std::string_view chunk) {
+                stream_.feed(chunk, [this](const std::string_view r) {
+                    parse_record(r);
+                });
+            }
+
+            inline void finish() {
+                stream_.finish([this](const std::string_view r) {
+                    parse_record(r);
+                });
+            }
+
+            inline std::uint64_t records() const {
+                return record_;
+            }
+
+            inline std::uint64_t malformed() const {
+                return malformed_;
+            }
+
+        private:
+            shape_buffers<T>* out_;
+            detail::record_stream<detail::json_split> stream_;
+            std::uint64_t record_ = 0;
+            std::uint64_t malformed_ = 0;
+
+            inline void parse_record(const std::string_view r) {
+                using kind = detail::json_split::kind;
+                const auto part = stream_.split().part;
+                if (part == kind::head || part == kind::tail) {
+                    return;
+                }
+                if (part == kind::truncated) {
+                    ++malformed_;
+                    ++record_;
+                    return;
+                }
+                detail::cursor c{r.data(), r.data() + r.size()};
+                if (part == kind::feature) {
+                    c.accept(',');
+                }
+                c.skip_ws();
+                if (c.done()) {
+                    return;
+                }
+                const detail::shape_marks marks(*out_);
+                if (object(c) && (c.skip_ws(), c.done())) {
+                    ++record_;
+                    return;
+                }
+                marks.rollback(*out_);
+                ++malformed_;
+                ++record_;
+            }
+
+            inline bool string(detail::cursor& c, std::string_view& out) {
+                if (!c.accept('"')) {
+                    return false;
+                }
+                const char* begin = c.p;
+                while (c.p != c.end && *c.p != '"') {
+                    if (*c.p == '\\' && ++c.p == c.end) {
+                        return false;
+                    }
+                    ++c.p;
+                }
+                if (c.p == c.end) {
+                    return false;
+                }
+                out = std::string_view(begin, c.p - begin);
+                ++c.p;
+                return true;
+            }
+
+            inline bool skip_value(detail::cursor& c) {
+                c.skip_ws();
+                if (c.done()) {
+                    return false;
+                }
+                std::string_view s;
+                switch (*c.p) {
+                    case '"':
+                        return string(c, s);
+                    case '{':
+                    case '[': {
+                        std::int32_t depth = 0;
+                        while (c.p != c.end) {
+                            const char ch = *c.p;
+                            if (ch == '"') {
+                                if (!string(c, s)) {
+                                    return false;
+                                }
+                                continue;
+                            }
+                            ++c.p;
+                            if (ch == '{' || ch == '[') {
+                                ++depth;
+                            } else if ((ch == '}' || ch == ']')
+                                    && --depth == 0) {
+                                return true;
+                            }
+                        }
+                        return false;
+                    }
+                    default:
+                        while (c.p != c.end && *c.p != ',' && *c.p != '}'
+                                && *c.p != ']' && *c.p != ' ' && *c.p != '\t'
+                                && *c.p != '\n' && *c.p != '\r') {
+                            ++c.p;
+                        }
+                        return true;
+                }
+            }
+
+            inline bool position(detail::cursor& c, T& x, T& y) {
+                if (!c.accept('[') || !c.number(x) || !c.accept(',')
+                        || !c.number(y)) {
+                    return false;
+                }
+                T skip;
+                while (c.accept(',')) {
+                    if (!c.number(skip)) {
+                        return false;
+                    }
+                }
+                return c.accept(']');
+            }
+
+            template <typename F>
+            inline bool array(detail::cursor& c, F&& f) {
+                if (!c.accept('[')) {
+                    return false;
+                }
+                if (c.accept(']')) {
+                    return true;
+                }
+                do {
+                    if (!f(c)) {
+                        return false;
+                    }
+                } while (c.accept(','));
+                return c.accept(']');
+            }
+
+            inline bool point(detail::cursor& c) {
+                T x;
+                T y;
+                if (!position(c, x, y)) {
+                    return false;
+                }
+                out_->points.push_back(x, y, record_);
+                return true;
+            }
+
+            inline bool linestring(detail::cursor& c) {
+                if (!c.accept('[')) {
+                    return false;
+                }
+                if (c.accept(']')) {
+                    return true;
+                }
+                T x0;
+                T y0;
+                if (!position(c, x0, y0)) {
+                    return false;
+                }
+                while (c.accept(',')) {
+                    T x1;
+                    T y1;
+                    if (!position(c, x1, y1)) {
+                        return false;
+                    }
+                    out_->lines.push_back(x0, y0, x1, y1, record_);
+                    x0 = x1;
+                    y0 = y1;
+                }
+                return c.accept(']');
+            }
+
+            inline bool polygon(detail::cursor& c) {
+                auto& p = out_->polygons;
+                p.begin_polygon(record_);
+                const bool ok = array(c, [this, &p](detail::cursor& c) {
+                    const bool ring = array(c, [&p, this](detail::cursor& c) {
+                        T x;
+                        T y;
+                        if (!position(c, x, y)) {
+                            return false;
+                        }
+                        p.push_vertex(x, y);
+                        return true;
+                    });
+                    p.end_ring();
+                    return ring;
+                });
+                p.end_polygon();
+                return ok;
+            }
+
+            inline bool coordinates(detail::cursor& c,
+                    const std::string_view type, const bool has_radius,
+                    const T radius) {
+                if (detail::iequals(type, "Point")) {
+                    return point(c);
+                }
+                if (detail::iequals(type, "LineString")) {
+                    return linestring(c);
+                }
+                if (detail::iequals(type, "Polygon")) {
+                    return polygon(c);
+                }
+                if (detail::iequals(type, "MultiPoint")) {
+                    return array(c, [this](detail::cursor& c) {
+                        return point(c);
+                    });
+                }
+                if (detail::iequals(type, "MultiLineString")) {
+                    return array(c, [this](detail::cursor& c) {
+                        return linestring(c);
+                    });
+                }
+                if (detail::iequals(type, "MultiPolygon")) {
+                    return array(c, [this](detail::cursor& c) {
+                        return polygon(c);
+                    });
+                }
+                if (detail::iequals(type, "envelope")) {
+                    T x0;
+                    T y1;
+                    T x1;
+                    T y0;
+                    if (!c.accept('[') || !position(c, x0, y1)
+                            || !c.accept(',') || !position(c, x1, y0)
+                            || !c.accept(']')) {
+                        return false;
+                    }
+                    out_->rects.push_back(x0, y0, x1 - x0, y1 - y0, record_);
+                    return true;
+                }
+                if (detail::iequals(type, "circle")) {
+                    T x;
+                    T y;
+                    if (!has_radius || !position(c, x, y)) {
+                        return false;
+                    }
+                    out_->circles.push_back(x, y, radius, record_);
+                    return true;
+                }
+                return false;
+            }
+
+            inline bool object(detail::cursor& c) {
+                if (!c.accept('{')) {
+                    return false;
+                }
+                std::string_view type;
+                const char* coords = nullptr;
+                const char* geometry = nullptr;
+                const char* children = nullptr;
+                bool has_radius = false;
+                T radius = T(0);
+                if (!c.accept('}')) {
+                    do {
+                        std::string_view key;
+                        if (!string(c, key) || !c.accept(':')) {
+                            return false;
+                        }
+                        c.skip_ws();
+                        if (key == "type") {
+                            if (!string(c, type)) {
+                                return false;
+                            }
+                            continue;
+                        }
+                        if (key == "radius") {
+                            if (!c.number(radius)) {
+                                return false;
+                            }
+                            has_radius = true;
+                            continue;
+                        }
+                        if (key == "coordinates") {
+                            coords = c.p;
+                        } else if (key == "geometry") {
+                            geometry = c.p;
+                        } else if (key == "geometries" || key == "features") {
+                            children = c.p;
+                        }
+                        if (!skip_value(c)) {
+                            return false;
+                        }
+                    } while (c.accept(','));
+                    if (!c.accept('}')) {
+                        return false;
+                    }
+                }
+
+                const char* end = c.p;
+                bool ok = true;
+                if (detail::iequals(type, "Feature")) {
+                    if (geometry != nullptr) {
+                        detail::cursor g{geometry, end};
+                        ok = g.keyword("null") || object(g);
+                    }
+                } else if (detail::iequals(type, "FeatureCollection")
+                        || detail::iequals(type, "GeometryCollection")) {
+                    if (children == nullptr) {
+                        return false;
+                    }
+                    detail::cursor g{children, end};
+                    ok = array(g, [this](detail::cursor& c) {
+                        return object(c);
+                    });
+                } else {
+                    if (coords == nullptr) {
+                        return false;
+                    }
+                    detail::cursor g{coords, end};
+                    ok = coordinates(g, type, has_radius, radius);
+                }
+                return ok;
+            }
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_IO_H
@@ -0,0 +1,269 @@
+#ifndef JNF_GEOMETRY_JOIN_H
+#define JNF_GEOMETRY_JOIN_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_pairs.h"
+#include "jnf_geometry_parallel.h"
+
+// Spatial join of two rect sets by partition-based spatial merge: both inputs
+// are distributed over a uniform grid, every rect being listed in each cell it
+// covers, and the cells are then joined independently by a plane sweep on
+// worker threads. A pair that meets in several cells is only reported by the
+// cell containing the lower left corner of its intersection, so no duplicate
+// elimination pass is needed.
+
+namespace jnf {
+    namespace geometry {
+        namespace detail {
+            struct join_grid {
+                vec2<double> lo;
+                vec2<double> scale;
+                std::uint32_t n = 1;
+
+                inline std::uint32_t cell(const double v, const double lo,
+                        const double scale) const {
+                    const auto c = (v - lo) * scale;
+                    if (!(c > 0)) {
+                        return 0;
+                    }
+                    return static_cast<std::uint32_t>(
+                            std::min(c, static_cast<double>(n - 1)));
+                }
+
+                inline std::uint32_t x(const double v) const {
+                    return cell(v, lo.x, scale.x);
+                }
+
+                inline std::uint32_t y(const double v) const {
+                    return cell(v, lo.y, scale.y);
+                }
+
+                // Picks the resolution so that cells hold a few hundred rects
+                // on average but are not much smaller than the rects
+                // themselves, which would only multiply the replicas.
+                template <typename T>
+                static inline join_grid fit(const std::span<const rect<T>> a,
+                        const std::span<const rect<T>> b) {
+                    join_grid g;
+                    vec2<double> lo(INFINITY, INFINITY);
+                    vec2<double> hi(-INFINITY, -INFINITY);
+                    vec2<double> extent;
+                    for (const auto rs : {a, b}) {
+                        for (const auto& r : rs) {
+                            const vec2<double> p(r.pos.x, r.pos.y);
+                            const vec2<double> s(r.size.x, r.size.y);
+                            lo = lo.min(p);
+                            hi = hi.max(p + s);
+                            extent = extent + s;
+                        }
+                    }
+                    const auto count = static_cast<double>(a.size() + b.size());
+                    if (count == 0 || !(hi.x >= lo.x) || !(hi.y >= lo.y)) {
+                        return g;
+                    }
+                    const auto span = hi - lo;
+                    extent = extent / count;
+                    auto n = std::sqrt(count / 256);
+                    if (extent.x > 0) {
+                        n = std::min(n, span.x / extent.x);
+                    }
+                    if (extent.y > 0) {
+                        n = std::min(n, span.y / extent.y);
+                    }
+                    g.n = static_cast<std::uint32_t>(
+                            std::clamp(n, 1.0, 1024.0));
+                    g.lo = lo;
+                    g.scale = vec2<double>(
+                            span.x > 0 ? g.n / span.x : 0,
+                            span.y > 0 ? g.n / span.y : 0);
+                    return g;
+                }
+            };
+
+            // Indices of one input grouped by cell, cell c owning
+            // items[offsets[c], offsets[c + 1]).
+            struct join_partition {
+                std::vector<std::size_t> offsets;
+                std::vector<std::uint32_t> items;
+            };
+
+            template <typename T>
+            inline join_partition partition(const std::span<const rect<T>> rs,
+                    const join_grid& g, const unsigned threads) {
+                const std::size_t cells = std::size_t(g.n) * g.n;
+                std::vector<std::atomic<std::size_t>> cursor(cells + 1);
+                const auto cover = [&rs, &g](const std::size_t i, auto&& f) {
+                    const auto& r = rs[i];
+                    const auto x0 = g.x(r.pos.x);
+                    const auto x1 = g.x(r.pos.x + r.size.x);
+                    const auto y0 = g.y(r.pos.y);
+                    const auto y1 = g.y(r.pos.y + r.size.y);
+                    for (auto y = y0; y <= y1; ++y) {
+                        for (auto x = x0; x <= x1; ++x) {
+                            f(std::size_t(y) * g.n + x);
+                        }
+                    }
+                };
+                parallel_for(threads, rs.size(), 4096, [&](std::size_t i) {
+                    cover(i, [&cursor](const std::size_t c) {
+                        cursor[c + 1].fetch_add(1, std::memory_order_relaxed);
+                    });
+                });
+                join_partition p;
+                p.offsets.resize(cells + 1);
+                for (std::size_t c = 0; c < cells; ++c) {
+                    p.offsets[c + 1] = p.offsets[c]
+                            + cursor[c + 1].load(std::memory_order_relaxed);
+                    cursor[c].store(p.offsets[c], std::memory_order_relaxed);
+                }
+                p.items.resize(p.offsets[cells]);
+                parallel_for(threads, rs.size(), 4096, [&](std::size_t i) {
+                    cover(i, [&cursor, &p, i](const std::size_t c) {
+                        p.items[cursor[c].fetch_add(1,
+                                std::memory_order_relaxed)] =
+                                static_cast<std::uint32_t>(i);
+                    });
+                });
+                return p;
+            }
+
+            // Plane sweep over the rects of one cell, both lists sorted by
+            // their left edge.
+            template <typename T, typename O>
+            inline void sweep(const std::span<const rect<T>> a,
+                    const std::span<const rect<T>> b,
+                    const std::span<std::uint32_t> ia,
+                    const std::span<std::uint32_t> ib,
+                    const join_grid& g, const std::uint32_t cx,
+                    const std::uint32_t cy, O& out) {
+                const auto by_x = [](const std::span<const rect<T>> rs) {
+                    return [rs](const std::uint32_t i, const std::uint32_t j) {
+                        return rs[i].pos.x < rs[j].pos.x
+                                || (rs[i].pos.x == rs[j].pos.x && i < j);
+                    };
+                };
+                std::sort(ia.begin(), ia.end(), by_x(a));
+                std::sort(ib.begin(), ib.end(), by_x(b));
+                const auto report = [&](const std::uint32_t i,
+                        const std::uint32_t j) {
+                    const auto& r1 = a[i];
+                    const auto& r2 = b[j];
+                    if (g.x(std::max(r1.pos.x, r2.pos.x)) != cx
+                            || g.y(std::max(r1.pos.y, r2.pos.y)) != cy) {
+                        return;
+                    }
+                    if (overlaps(r1, r2)) {
+                        out.emplace_back(i, j);
+                    }
+                };
+                std::size_t i = 0;
+                std::size_t j = 0;
+                while (i < ia.size() && j < ib.size()) {
+                    if (a[ia[i]].pos.x <= b[ib[j]].pos.x) {
+                        const auto& r = a[ia[i]];
+                        const auto x1 = r.pos.x + r.size.x;
+                        for (auto k = j; k < ib.size()
+                                && b[ib[k]].pos.x <= x1; ++k) {
+                            report(ia[i], ib[k]);
+                        }
+                        ++i;
+                    } else {
+                        const auto& r = b[ib[j]];
+                        const auto x1 = r.pos.x + r.size.x;
+                        for (auto k = i; k < ia.size()
+                                && a[ia[k]].pos.x <= x1; ++k) {
+                            report(ia[k], ib[j]);
+                        }
+                        ++j;
+                    }
+                }
+            }
+
+            // Joins the cells on n threads, worker t appending its pairs to
+            // found[t].
+            template <typename T, typename O>
+            inline void join(const std::span<const rect<T>> a,
+                    const std::span<const rect<T>> b, const unsigned n,
+                    std::vector<O>& found) {
+                const auto g = join_grid::fit(a, b);
+                auto pa = partition(a, g, n);
+                auto pb = partition(b, g, n);
+                std::atomic<std::size_t> next{0};
+                const std::size_t cells = std::size_t(g.n) * g.n;
+                parallel(n, [&](const unsigned t) {
+                    auto& out = found[t];
+                    for (;;) {
+                        const auto c = next.fetch_add(1,
+                                std::memory_order_relaxed);
+                        if (c >= cells) {
+                            return;
+                        }
+                        const std::span<std::uint32_t> ia(
+                                pa.items.data() + pa.offsets[c],
+                                pa.items.data() + pa.offsets[c + 1]);
+                        const std::span<std::uint32_t> ib(
+                                pb.items.data() + pb.offsets[c],
+                                pb.items.data() + pb.offsets[c + 1]);
+                        if (ia.empty() || ib.empty()) {
+                            continue;
+                        }
+                        sweep(a, b, ia, ib, g,
+                                static_cast<std::uint32_t>(c % g.n),
+                                static_cast<std::uint32_t>(c / g.n), out);
+                    }
+                });
+            }
+        }
+
+        // All pairs (i, j) with overlaps(a[i], b[j]), each reported once and
+        // in no particular order. threads = 0 uses every hardware thread.
+        template <typename T>
+        inline std::vector<index_pair> overlap_join(
+                const std::span<const rect<T>> a,
+                const std::span<const rect<T>> b, const unsigned threads = 0) {
+            const auto n = detail::workers(threads);
+            std::vector<std::vector<index_pair>> found(n);
+            detail::join(a, b, n, found);
+            std::size_t total = 0;
+            for (const auto& f : found) {
+                total += f.size();
+            }
+            std::vector<index_pair> ret;
+            ret.reserve(total);
+            for (const auto& f : found) {
+                ret.insert(ret.end(), f.begin(), f.end());
+            }
+            return ret;
+        }
+
+        // As above, replacing out.candidates with the pairs and reusing the
+        // buffer's storage.
+        template <typename T>
+        inline void overlap_join(const std::span<const rect<T>> a,
+                const std::span<const rect<T>> b, pair_buffer& out,
+                const unsigned threads = 0) {
+            const auto n = detail::workers(threads);
+            detail::join(a, b, n, out.begin_parts(n));
+            out.candidates.clear();
+            out.gather(out.candidates);
+        }
+
+        template <typename T>
+        inline std::vector<index_pair> overlap_join(
+                const std::vector<rect<T>>& a, const std::vector<rect<T>>& b,
+                const unsigned threads = 0) {
+            return overlap_join(std::span<const rect<T>>(a),
+                    std::span<const rect<T>>(b), threads);
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_JOIN_H
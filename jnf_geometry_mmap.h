@@ -0,0 +1,166 @@
+#ifndef JNF_GEOMETRY_MMAP_H
+#define JNF_GEOMETRY_MMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file. On POSIX systems the file is memory mapped
+// and paging hints are forwarded to madvise; elsewhere it is read into memory
+// and the hints do nothing.
+
+namespace jnf {
+    namespace geometry {
+        namespace detail {
+            // Scalar type tag stored in file headers so that a file is only
+            // read back with the scalar type it was written with.
+            template <typename T>
+            inline constexpr std::uint32_t scalar_tag() {
+                return static_cast<std::uint32_t>(sizeof(T))
+                        | (std::is_floating_point_v<T> ? 0x100 : 0);
+            }
+        }
+
+        class mapped_file {
+        public:
+            inline mapped_file() = default;
+
+            mapped_file(const mapped_file&) = delete;
+
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            inline mapped_file(mapped_file&& m) noexcept {
+                *this = std::move(m);
+            }
+
+            inline mapped_file& operator=(mapped_file&& m) noexcept {
+                if (this != &m) {
+                    close();
+                    data_ = std::exchange(m.data_, nullptr);
+                    size_ = std::exchange(m.size_, 0);
+                    copy_ = std::move(m.copy_);
+                }
+                return *this;
+            }
+
+            inline ~mapped_file() {
+                close();
+            }
+
+            inline bool open(const std::string& path) {
+                close();
+#if defined(__unix__) || defined(__APPLE__)
+                const int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    return false;
+                }
+                struct stat st;
+                if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+                    ::close(fd);
+                    return false;
+                }
+                void* p = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                        PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (p == MAP_FAILED) {
+                    return false;
+                }
+                data_ = static_cast<const std::byte*>(p);
+                size_ = static_cast<std::size_t>(st.st_size);
+                return true;
+#else
+                std::FILE* f = std::fopen(path.c_str(), "rb");
+                if (f == nullptr) {
+                    return false;
+                }
+                std::byte buf[1 << 16];
+                std::size_t n;
+                while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+                    copy_.insert(copy_.end(), buf, buf + n);
+                }
+                std::fclose(f);
+                if (copy_.empty()) {
+                    return false;
+                }
+                data_ = copy_.data();
+                size_ = copy_.size();
+                return true;
+#endif
+            }
+
+            inline void close() {
+#if defined(__unix__) || defined(__APPLE__)
+                if (data_ != nullptr) {
+                    munmap(const_cast<std::byte*>(data_), size_);
+                }
+#endif
+                data_ = nullptr;
+                size_ = 0;
+                copy_.clear();
+            }
+
+            inline bool is_open() const {
+                return data_ != nullptr;
+            }
+
+            inline const std::byte* data() const {
+                return data_;
+            }
+
+            inline std::size_t size() const {
+                return size_;
+            }
+
+            // Asks for the byte range to be read ahead.
+            inline void will_need(const std::size_t offset,
+                    const std::size_t length) const {
+                advise(offset, length, true);
+            }
+
+            // Lets the range be dropped from the process; it is faulted back
+            // in from the file on the next access.
+            inline void dont_need(const std::size_t offset,
+                    const std::size_t length) const {
+                advise(offset, length, false);
+            }
+
+        private:
+            const std::byte* data_ = nullptr;
+            std::size_t size_ = 0;
+            std::vector<std::byte> copy_;
+
+            inline void advise(const std::size_t offset,
+                    const std::size_t length, const bool need) const {
+#if defined(__unix__) || defined(__APPLE__)
+                if (data_ == nullptr || offset >= size_) {
+                    return;
+                }
+                static const auto os_page =
+                        static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+                const auto begin = offset / os_page * os_page;
+                const auto end = std::min(size_, offset + length);
+                madvise(const_cast<std::byte*>(data_) + begin, end - begin,
+                        need ? MADV_WILLNEED : MADV_DONTNEED);
+#else
+                (void) offset;
+                (void) length;
+                (void) need;
+#endif
+            }
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_MMAP_H
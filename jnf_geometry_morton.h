@@ -0,0 +1,227 @@
+#ifndef JNF_GEOMETRY_MORTON_H
+#define JNF_GEOMETRY_MORTON_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_parallel.h"
+
+// Morton (Z-order) codes and spatial sorting of shape arrays. Coordinates are
+// quantized to 32 bits over the bounds of the set and their bits interleaved,
+// so that sorting by code lays out nearby shapes next to each other in
+// memory. Shapes other than points are keyed by the center of their
+// envelope_r. Sorting is a parallel LSD radix sort over (code, index) pairs:
+// each thread histograms and scatters one contiguous slice, which keeps the
+// sort stable and its result independent of the thread count.
+
+namespace jnf {
+    namespace geometry {
+        namespace detail {
+            // Spreads the low 32 bits of v over the even bit positions.
+            inline constexpr std::uint64_t spread(std::uint64_t v) {
+                v &= 0xffffffffull;
+                v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+                v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+                v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+                v = (v | (v << 2)) & 0x3333333333333333ull;
+                v = (v | (v << 1)) & 0x5555555555555555ull;
+                return v;
+            }
+
+            template <typename T>
+            inline vec2<T> key_point(const vec2<T>& p) {
+                return p;
+            }
+
+            template <typename S>
+            inline auto key_point(const S& shape) {
+                return envelope_r(shape).center();
+            }
+
+            // Bounds of the key points, the unit rect if there are none.
+            template <typename T, typename S>
+            inline rect<T> key_bounds(const std::span<const S> shapes) {
+                vec2<T> lo(std::numeric_limits<T>::max(),
+                        std::numeric_limits<T>::max());
+                vec2<T> hi(std::numeric_limits<T>::lowest(),
+                        std::numeric_limits<T>::lowest());
+                for (const auto& s : shapes) {
+                    const auto p = key_point(s);
+                    lo = lo.min(p);
+                    hi = hi.max(p);
+                }
+                if (!(hi.x >= lo.x) || !(hi.y >= lo.y)) {
+                    return rect<T>();
+                }
+                return rect<T>(lo, hi - lo);
+            }
+        }
+
+        inline constexpr std::uint64_t morton(const std::uint32_t x,
+                const std::uint32_t y) {
+            return detail::spread(x) | (detail::spread(y) << 1);
+        }
+
+        // Quantization of a region to the 2^32 x 2^32 grid of the codes.
+        // Points outside the region are clamped to its border.
+        template <typename T>
+        struct morton_grid {
+            vec2<double> lo;
+            vec2<double> scale;
+
+            inline explicit morton_grid(const rect<T>& bounds = rect<T>()) {
+                const double q = 4294967295.0;
+                lo = vec2<double>(bounds.pos.x, bounds.pos.y);
+                scale = vec2<double>(
+                        bounds.size.x > 0 ? q / bounds.size.x : 0,
+                        bounds.size.y > 0 ? q / bounds.size.y : 0);
+            }
+
+            // Grid over the key points of the shapes.
+            template <typename S>
+            static inline morton_grid fit(const std::span<const S> shapes) {
+                return morton_grid(detail::key_bounds<T>(shapes));
+            }
+
+            inline std::uint64_t code(const vec2<T>& p) const {
+                const double q = 4294967295.0;
+                const auto x = std::clamp((p.x - lo.x) * scale.x, 0.0, q);
+                const auto y = std::clamp((p.y - lo.y) * scale.y, 0.0, q);
+                return morton(static_cast<std::uint32_t>(x),
+                        static_cast<std::uint32_t>(y));
+            }
+
+            template <typename S>
+            inline std::uint64_t code(const S& shape) const {
+                return code(detail::key_point(shape));
+            }
+        };
+
+        namespace detail {
+            // Stable LSD radix sort of idx by keys, 11 bits per pass. Passes
+            // in which every key has the same digit are skipped. Scratch
+            // space comes from the allocators of the two vectors.
+            template <typename K, typename I>
+            inline void radix_sort(K& keys, I& idx, const unsigned threads) {
+                constexpr unsigned bits = 11;
+                constexpr std::size_t buckets = std::size_t(1) << bits;
+                const auto n = keys.size();
+                const auto workers = static_cast<unsigned>(std::min<
+                        std::size_t>(threads, std::max<std::size_t>(1,
+                        n / 65536)));
+                using counts_alloc = typename std::allocator_traits<
+                        typename I::allocator_type>::template rebind_alloc<
+                        std::size_t>;
+                K keys2(n, keys.get_allocator());
+                I idx2(n, idx.get_allocator());
+                std::vector<std::size_t, counts_alloc> counts(
+                        workers * buckets, counts_alloc(idx.get_allocator()));
+                for (unsigned shift = 0; shift < 64; shift += bits) {
+                    std::fill(counts.begin(), counts.end(), 0);
+                    parallel(workers, [&](const unsigned t) {
+                        auto* c = counts.data() + t * buckets;
+                        for (auto i = n * t / workers;
+                                i < n * (t + 1) / workers; ++i) {
+                            ++c[(keys[i] >> shift) & (buckets - 1)];
+                        }
+                    });
+                    // Bucket-major, then thread-major offsets.
+                    std::size_t sum = 0;
+                    bool trivial = false;
+                    for (std::size_t b = 0; b < buckets; ++b) {
+                        std::size_t total = 0;
+                        for (unsigned t = 0; t < workers; ++t) {
+                            const auto c = counts[t * buckets + b];
+                            counts[t * buckets + b] = sum + total;
+                            total += c;
+                        }
+                        trivial = trivial || total == n;
+                        sum += total;
+                    }
+                    if (trivial) {
+                        continue;
+                    }
+                    parallel(workers, [&](const unsigned t) {
+                        auto* c = counts.data() + t * buckets;
+                        for (auto i = n * t / workers;
+                                i < n * (t + 1) / workers; ++i) {
+                            const auto at = c[(keys[i] >> shift)
+                                    & (buckets - 1)]++;
+                            keys2[at] = keys[i];
+                            idx2[at] = idx[i];
+                        }
+                    });
+                    keys.swap(keys2);
+                    idx.swap(idx2);
+                }
+            }
+        }
+
+        // Writes the code of every shape to codes, which must hold
+        // shapes.size() values.
+        template <typename T, typename S>
+        inline void morton_codes(const morton_grid<T>& grid,
+                const std::span<const S> shapes,
+                const std::span<std::uint64_t> codes,
+                const unsigned threads = 0) {
+            detail::parallel_for(detail::workers(threads), shapes.size(),
+                    16384, [&](const std::size_t i) {
+                codes[i] = grid.code(shapes[i]);
+            });
+        }
+
+        // Indices of the shapes in Z-order: shapes[order[0]] comes first.
+        // Equal codes keep their input order. threads = 0 uses every
+        // hardware thread. The order and the scratch space of the sort are
+        // allocated with alloc.
+        template <typename S,
+                detail::allocator A = std::allocator<std::uint32_t>>
+        inline std::vector<std::uint32_t, A> morton_order(
+                const std::span<const S> shapes, const unsigned threads = 0,
+                const A& alloc = A()) {
+            using T = detail::scalar_t<S>;
+            using keys_alloc = typename std::allocator_traits<A>::
+                    template rebind_alloc<std::uint64_t>;
+            const auto workers = detail::workers(threads);
+            std::vector<std::uint64_t, keys_alloc> keys(shapes.size(),
+                    keys_alloc(alloc));
+            morton_codes(morton_grid<T>::fit(shapes), shapes,
+                    std::span<std::uint64_t>(keys), workers);
+            std::vector<std::uint32_t, A> order(shapes.size(), alloc);
+            for (std::size_t i = 0; i < order.size(); ++i) {
+                order[i] = static_cast<std::uint32_t>(i);
+            }
+            detail::radix_sort(keys, order, workers);
+            return order;
+        }
+
+        // Reorders the shapes along the Z-order curve and returns the
+        // permutation applied, order[i] being the former index of the shape
+        // now at i, so that data kept alongside can follow. The reordered
+        // copy uses the allocator of shapes, the permutation alloc.
+        template <typename S, typename SA,
+                detail::allocator A = std::allocator<std::uint32_t>>
+        inline std::vector<std::uint32_t, A> morton_sort(
+                std::vector<S, SA>& shapes, const unsigned threads = 0,
+                const A& alloc = A()) {
+            auto order = morton_order(std::span<const S>(shapes), threads,
+                    alloc);
+            std::vector<S, SA> sorted(shapes.size(), shapes.get_allocator());
+            detail::parallel_for(detail::workers(threads), shapes.size(),
+                    16384, [&](const std::size_t i) {
+                sorted[i] = shapes[order[i]];
+            });
+            shapes.swap(sorted);
+            return order;
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_MORTON_H
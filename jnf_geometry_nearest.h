@@ -0,0 +1,151 @@
+#ifndef JNF_GEOMETRY_NEAREST_H
+#define JNF_GEOMETRY_NEAREST_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_bvh.h"
+
+// Nearest shape queries for many points at once. Each query descends a
+// dynamic_bvh over the shapes' envelopes nearer child first and prunes every
+// subtree whose box is already further than the best point found, so only
+// the shapes around the query have closest() evaluated. Consecutive queries
+// are usually near each other (successive fixes along a track), so each one
+// starts from the shape that won the previous query: its distance is a tight
+// bound before the descent begins.
+
+namespace jnf {
+    namespace geometry {
+        template <typename T>
+        struct closest_hit {
+            static constexpr std::uint32_t none =
+                    std::numeric_limits<std::uint32_t>::max();
+
+            vec2<T> point;
+            std::uint32_t index = none;
+            T distance = std::numeric_limits<T>::max();
+        };
+
+        namespace detail {
+            template <typename T>
+            inline T distance2(const rect<T>& r, const vec2<T>& p) {
+                return (p.clamp(r.pos, r.pos + r.size) - p).mag2();
+            }
+        }
+
+        // Fills out[i] with the nearest point to points[i] over the shapes in
+        // tree, where closest_of(id, p) returns the point of shape id nearest
+        // to p. The ids are those the shapes were inserted with, so one tree
+        // may index shapes of different types. out must hold points.size()
+        // hits; with an empty tree every hit has index closest_hit::none.
+        template <typename T, typename F>
+        inline void closest_batch(const dynamic_bvh<T>& tree,
+                const std::span<const vec2<T>> points,
+                const std::span<closest_hit<T>> out, F&& closest_of) {
+            constexpr auto null = dynamic_bvh<T>::null;
+            std::vector<std::int32_t> stack;
+            auto prev = closest_hit<T>::none;
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                const auto& p = points[i];
+                closest_hit<T> best;
+                T best2 = std::numeric_limits<T>::max();
+                const auto visit = [&](const std::uint32_t id) {
+                    const vec2<T> q = closest_of(id, p);
+                    const auto d2 = (q - p).mag2();
+                    if (d2 < best2) {
+                        best2 = d2;
+                        best.point = q;
+                        best.index = id;
+                    }
+                };
+                if (prev != closest_hit<T>::none) {
+                    visit(prev);
+                }
+                if (tree.root() != null) {
+                    stack.push_back(tree.root());
+                }
+                while (!stack.empty()) {
+                    const auto n = stack.back();
+                    stack.pop_back();
+                    if (detail::distance2(tree.bounds(n), p) >= best2) {
+                        continue;
+                    }
+                    const auto l = tree.left(n);
+                    if (l == null) {
+                        if (tree.id(n) != prev) {
+                            visit(tree.id(n));
+                        }
+                        continue;
+                    }
+                    const auto r = tree.right(n);
+                    const auto dl = detail::distance2(tree.bounds(l), p);
+                    const auto dr = detail::distance2(tree.bounds(r), p);
+                    // The nearer child goes on top to tighten the bound
+                    // before the other one is tested.
+                    if (dl < dr) {
+                        stack.push_back(r);
+                        stack.push_back(l);
+                    } else {
+                        stack.push_back(l);
+                        stack.push_back(r);
+                    }
+                }
+                if (best.index != closest_hit<T>::none) {
+                    best.distance = std::sqrt(best2);
+                }
+                out[i] = best;
+                prev = best.index;
+            }
+        }
+
+        // As above for a tree built over shapes with insert(shapes[i], i).
+        template <typename T, typename S>
+        inline void closest_batch(const dynamic_bvh<T>& tree,
+                const std::span<const S> shapes,
+                const std::span<const vec2<T>> points,
+                const std::span<closest_hit<T>> out) {
+            closest_batch(tree, points, out,
+                    [shapes](const std::uint32_t id, const vec2<T>& p) {
+                return closest(shapes[id], p);
+            });
+        }
+
+        // Nearest point of any of the shapes, and its index, for each point,
+        // in a vector allocated with alloc. Builds the index on every call,
+        // on the default heap; keep a dynamic_bvh and use the overloads above
+        // when the shapes outlive one batch or no allocation may reach the
+        // heap.
+        template <typename T, typename S,
+                detail::allocator A = std::allocator<closest_hit<T>>>
+        inline std::vector<closest_hit<T>, A> closest_batch(
+                const std::span<const vec2<T>> points,
+                const std::span<const S> shapes, const A& alloc = A()) {
+            dynamic_bvh<T> tree;
+            for (std::size_t i = 0; i < shapes.size(); ++i) {
+                tree.insert(shapes[i], static_cast<std::uint32_t>(i));
+            }
+            tree.rebuild();
+            std::vector<closest_hit<T>, A> out(points.size(), alloc);
+            closest_batch(tree, shapes, points,
+                    std::span<closest_hit<T>>(out));
+            return out;
+        }
+
+        template <typename T, typename S,
+                detail::allocator A = std::allocator<closest_hit<T>>>
+        inline std::vector<closest_hit<T>, A> closest_batch(
+                const std::vector<vec2<T>>& points,
+                const std::vector<S>& shapes, const A& alloc = A()) {
+            return closest_batch(std::span<const vec2<T>>(points),
+                    std::span<const S>(shapes), alloc);
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_NEAREST_H
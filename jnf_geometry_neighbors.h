@@ -0,0 +1,236 @@
+#ifndef JNF_GEOMETRY_NEIGHBORS_H
+#define JNF_GEOMETRY_NEIGHBORS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_pairs.h"
+#include "jnf_geometry_parallel.h"
+
+// Fixed-radius neighbour search over point sets with cell lists. Points are
+// binned into a uniform grid whose cells are at least the search radius wide,
+// so every neighbour of a point lies in its own cell or one of the eight
+// around it. The bins are built by a stable counting sort into one flat
+// array, the positions copied alongside in cell order so that the pair scan
+// streams through memory. Each cell is compared with itself and with four of
+// its neighbours (right, and the three below), which visits every pair of
+// adjacent cells exactly once.
+
+namespace jnf {
+    namespace geometry {
+        template <typename T>
+        class neighbor_grid {
+        public:
+            // Bins the points for searches within radius. The grid keeps
+            // its storage between builds, so rebuilding every step of a
+            // simulation does not reallocate once the sizes settle.
+            inline void build(const std::span<const vec2<T>> points,
+                    const T radius, const unsigned threads = 0) {
+                const auto n = points.size();
+                const auto workers = detail::workers(threads);
+                r2_ = radius * radius;
+                vec2<T> lo(INFINITY, INFINITY);
+                vec2<T> hi(-INFINITY, -INFINITY);
+                for (const auto& p : points) {
+                    lo = lo.min(p);
+                    hi = hi.max(p);
+                }
+                if (n == 0 || !(hi.x >= lo.x) || !(hi.y >= lo.y)) {
+                    lo = hi = vec2<T>(T(0), T(0));
+                }
+                // Cells narrower than the radius would miss neighbours; on
+                // sparse sets they are widened to keep about two points per
+                // cell rather than a mostly empty grid.
+                const auto span = hi - lo;
+                const auto area = double(span.x) * double(span.y);
+                auto size = std::max(double(radius),
+                        std::sqrt(area / (2.0 * double(std::max<std::size_t>(
+                        n, 1)))));
+                size = std::max({size, double(span.x) / 65536.0,
+                        double(span.y) / 65536.0});
+                const auto inv = size > 0 ? 1.0 / size : 0.0;
+                lo_ = lo;
+                inv_ = T(inv);
+                nx_ = static_cast<std::uint32_t>(span.x * inv) + 1;
+                ny_ = static_cast<std::uint32_t>(span.y * inv) + 1;
+
+                key_.resize(n);
+                detail::parallel_for(workers, n, 16384, [&](std::size_t i) {
+                    key_[i] = cell(points[i]);
+                });
+                const std::size_t cells = std::size_t(nx_) * ny_;
+                start_.assign(cells + 1, 0);
+                for (std::size_t i = 0; i < n; ++i) {
+                    ++start_[key_[i] + 1];
+                }
+                for (std::size_t c = 0; c < cells; ++c) {
+                    start_[c + 1] += start_[c];
+                }
+                cursor_.assign(start_.begin(), start_.end() - 1);
+                order_.resize(n);
+                sorted_.resize(n);
+                for (std::size_t i = 0; i < n; ++i) {
+                    const auto at = cursor_[key_[i]]++;
+                    order_[at] = static_cast<std::uint32_t>(i);
+                    sorted_[at] = points[i];
+                }
+            }
+
+            // All pairs (i, j), i < j, of points at most radius apart, in no
+            // particular order. The previous contents of out are replaced.
+            inline void pairs(std::vector<index_pair>& out,
+                    const unsigned threads = 0) {
+                const auto workers = detail::workers(threads);
+                found_.resize(workers);
+                for (auto& f : found_) {
+                    f.clear();
+                }
+                run(workers, found_);
+                std::size_t total = 0;
+                for (const auto& f : found_) {
+                    total += f.size();
+                }
+                out.clear();
+                out.reserve(total);
+                for (const auto& f : found_) {
+                    out.insert(out.end(), f.begin(), f.end());
+                }
+            }
+
+            // As above, replacing out.candidates with the pairs.
+            inline void pairs(pair_buffer& out, const unsigned threads = 0) {
+                const auto workers = detail::workers(threads);
+                run(workers, out.begin_parts(workers));
+                out.candidates.clear();
+                out.gather(out.candidates);
+            }
+
+            inline std::vector<index_pair> pairs(const unsigned threads = 0) {
+                std::vector<index_pair> out;
+                pairs(out, threads);
+                return out;
+            }
+
+            inline std::size_t size() const {
+                return order_.size();
+            }
+
+            inline std::size_t cells() const {
+                return std::size_t(nx_) * ny_;
+            }
+
+        private:
+            vec2<T> lo_;
+            T inv_ = T(0);
+            T r2_ = T(0);
+            std::uint32_t nx_ = 0;
+            std::uint32_t ny_ = 0;
+            std::vector<std::uint32_t> key_;
+            std::vector<std::uint32_t> start_;
+            std::vector<std::uint32_t> cursor_;
+            std::vector<std::uint32_t> order_;
+            std::vector<vec2<T>> sorted_;
+            std::vector<std::vector<index_pair>> found_;
+
+            // Hands out rows of cells to the workers, worker t appending its
+            // pairs to found[t].
+            template <typename O>
+            inline void run(const unsigned workers,
+                    std::vector<O>& found) const {
+                std::atomic<std::uint32_t> next{0};
+                detail::parallel(workers, [&](const unsigned t) {
+                    auto& out = found[t];
+                    for (;;) {
+                        const auto y = next.fetch_add(1,
+                                std::memory_order_relaxed);
+                        if (y >= ny_) {
+                            return;
+                        }
+                        for (std::uint32_t x = 0; x < nx_; ++x) {
+                            scan(x, y, out);
+                        }
+                    }
+                });
+            }
+
+            inline std::uint32_t cell(const vec2<T>& p) const {
+                const auto fx = (p.x - lo_.x) * inv_;
+                const auto fy = (p.y - lo_.y) * inv_;
+                const auto x = fx > 0 ? std::min(nx_ - 1,
+                        static_cast<std::uint32_t>(fx)) : 0u;
+                const auto y = fy > 0 ? std::min(ny_ - 1,
+                        static_cast<std::uint32_t>(fy)) : 0u;
+                return y * nx_ + x;
+            }
+
+            template <typename O>
+            inline void emit(const std::uint32_t a, const std::uint32_t b,
+                    O& out) const {
+                if ((sorted_[a] - sorted_[b]).mag2() <= r2_) {
+                    const auto i = order_[a];
+                    const auto j = order_[b];
+                    out.emplace_back(std::min(i, j), std::max(i, j));
+                }
+            }
+
+            template <typename O>
+            inline void scan(const std::uint32_t x, const std::uint32_t y,
+                    O& out) const {
+                const auto c = std::size_t(y) * nx_ + x;
+                const auto b0 = start_[c];
+                const auto e0 = start_[c + 1];
+                if (b0 == e0) {
+                    return;
+                }
+                for (auto a = b0; a < e0; ++a) {
+                    for (auto b = a + 1; b < e0; ++b) {
+                        emit(a, b, out);
+                    }
+                }
+                constexpr std::int32_t dx[] = {1, -1, 0, 1};
+                constexpr std::int32_t dy[] = {0, 1, 1, 1};
+                for (auto k = 0; k < 4; ++k) {
+                    const auto nx = std::int64_t(x) + dx[k];
+                    const auto ny = std::int64_t(y) + dy[k];
+                    if (nx < 0 || nx >= nx_ || ny >= ny_) {
+                        continue;
+                    }
+                    const auto d = std::size_t(ny) * nx_ + std::size_t(nx);
+                    const auto b1 = start_[d];
+                    const auto e1 = start_[d + 1];
+                    for (auto a = b0; a < e0; ++a) {
+                        for (auto b = b1; b < e1; ++b) {
+                            emit(a, b, out);
+                        }
+                    }
+                }
+            }
+        };
+
+        // All pairs of points at most radius apart; see neighbor_grid.
+        template <typename T>
+        inline std::vector<index_pair> neighbor_pairs(
+                const std::span<const vec2<T>> points, const T radius,
+                const unsigned threads = 0) {
+            neighbor_grid<T> grid;
+            grid.build(points, radius, threads);
+            return grid.pairs(threads);
+        }
+
+        template <typename T>
+        inline std::vector<index_pair> neighbor_pairs(
+                const std::vector<vec2<T>>& points, const T radius,
+                const unsigned threads = 0) {
+            return neighbor_pairs(std::span<const vec2<T>>(points), radius,
+                    threads);
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_NEIGHBORS_H
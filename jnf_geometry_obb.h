@@ -0,0 +1,631 @@
+#ifndef JNF_GEOMETRY_OBB_H
+#define JNF_GEOMETRY_OBB_H
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include "jnf_geometry.h"
+
+namespace jnf {
+    namespace geometry {
+        // Oriented rectangle: a center, the half extents along its own axes
+        // and the unit direction of its first axis, the second being its
+        // perpendicular. Keeping the axis as a unit vector lets the
+        // separating axis tests use it directly, without trigonometry.
+        //
+        // The box is solid and closed for contains and overlaps: a shape
+        // inside it or touching it overlaps it. The rect overloads of
+        // jnf_geometry.h differ, so obb<T>(r) and r may answer differently:
+        // overlaps(rect, line) only tests the sides of the rect,
+        // overlaps(rect, rect) is half-open, and the circle tests against
+        // rects and lines are strict.
+        template <typename T>
+        struct obb {
+            vec2<T> center;
+            vec2<T> half;
+            vec2<T> axis{T(1), T(0)};
+
+            inline explicit obb(const vec2<T>& center = {T(0), T(0)},
+                    const vec2<T>& half = {T(0.5), T(0.5)},
+                    const T angle = T(0)) : center(center), half(half),
+                    axis(std::cos(angle), std::sin(angle)) {
+            }
+
+            inline explicit obb(const rect<T>& r)
+                    : center(r.center()), half(r.size * T(0.5)) {
+            }
+
+            inline constexpr vec2<T> up() const {
+                return axis.perp();
+            }
+
+            // Coordinates of p in the frame of the box.
+            inline constexpr vec2<T> local(const vec2<T>& p) const {
+                const auto d = p - center;
+                return vec2<T>(d.dot(axis), d.dot(up()));
+            }
+
+            inline constexpr vec2<T> world(const vec2<T>& q) const {
+                return center + axis * q.x + up() * q.y;
+            }
+
+            // Corners in counter-clockwise order of the box frame.
+            inline vec2<T> corner(const int32_t i) const {
+                switch (i % 4) {
+                    case 0:
+                        return world(-half);
+                    case 1:
+                        return world({half.x, -half.y});
+                    case 2:
+                        return world(half);
+                    default:
+                        return world({-half.x, half.y});
+                }
+            }
+
+            inline line<T> side(const int32_t i) const {
+                return line<T>(corner(i), corner(i + 1));
+            }
+
+            // Half the length of the projection onto the unit vector a.
+            inline T extent(const vec2<T>& a) const {
+                return half.x * std::abs(axis.dot(a))
+                        + half.y * std::abs(up().dot(a));
+            }
+
+            inline constexpr T area() const {
+                return T(4) * half.x * half.y;
+            }
+
+            inline constexpr T perim() const {
+                return T(4) * (half.x + half.y);
+            }
+        };
+
+        namespace detail {
+            // Separating axis test for two oriented boxes; only the four
+            // face normals need checking in 2D.
+            template <typename T1, typename T2>
+            inline bool sat(const obb<T1>& a, const obb<T2>& b) {
+                const auto d = b.center - a.center;
+                for (const auto& n : {a.axis, a.up(), b.axis, b.up()}) {
+                    if (std::abs(d.dot(n)) > a.extent(n) + b.extent(n)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Segment against box, in the frame of the box: the box axes
+            // and the segment normal.
+            template <typename T1, typename T2>
+            inline bool sat(const obb<T1>& o, const line<T2>& l) {
+                const auto p0 = o.local(l.start);
+                const auto p1 = o.local(l.end);
+                const auto m = (p0 + p1) * T1(0.5);
+                const auto e = (p1 - p0) * T1(0.5);
+                if (std::abs(m.x) > o.half.x + std::abs(e.x)
+                        || std::abs(m.y) > o.half.y + std::abs(e.y)) {
+                    return false;
+                }
+                const auto n = e.perp();
+                return std::abs(m.dot(n)) <= o.half.x * std::abs(n.x)
+                        + o.half.y * std::abs(n.y);
+            }
+        }
+
+        template<typename T1, typename T2>
+        inline vec2<T1> closest(const obb<T1>& o, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(closest, o, p);
+            auto q = o.local(p);
+            const auto dx = o.half.x - std::abs(q.x);
+            const auto dy = o.half.y - std::abs(q.y);
+            if (dx < 0 || dy < 0) {
+                q = q.clamp(-o.half, o.half);
+            } else if (dx < dy) {
+                q.x = q.x < 0 ? -o.half.x : o.half.x;
+            } else {
+                q.y = q.y < 0 ? -o.half.y : o.half.y;
+            }
+            return o.world(q);
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const obb<T1>& o, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(contains, o, p);
+            const auto q = o.local(p);
+            return JNF_GEOMETRY_RESULT(std::abs(q.x) <= o.half.x
+                    && std::abs(q.y) <= o.half.y);
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const obb<T1>& o, const line<T2>& l) {
+            JNF_GEOMETRY_PROBE(contains, o, l);
+            return JNF_GEOMETRY_RESULT(
+                    contains(o, l.start) && contains(o, l.end));
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const obb<T1>& o, const rect<T2>& r) {
+            JNF_GEOMETRY_PROBE(contains, o, r);
+            return JNF_GEOMETRY_RESULT(contains(o, r.pos)
+                    && contains(o, vec2<T2>(r.pos.x + r.size.x, r.pos.y))
+                    && contains(o, vec2<T2>(r.pos.x, r.pos.y + r.size.y))
+                    && contains(o, r.pos + r.size));
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const obb<T1>& o, const circle<T2>& c) {
+            JNF_GEOMETRY_PROBE(contains, o, c);
+            const auto q = o.local(c.center);
+            return JNF_GEOMETRY_RESULT(std::abs(q.x) + c.radius <= o.half.x
+                    && std::abs(q.y) + c.radius <= o.half.y);
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const obb<T1>& o1, const obb<T2>& o2) {
+            JNF_GEOMETRY_PROBE(contains, o1, o2);
+            return JNF_GEOMETRY_RESULT(contains(o1, o2.corner(0))
+                    && contains(o1, o2.corner(1))
+                    && contains(o1, o2.corner(2))
+                    && contains(o1, o2.corner(3)));
+        }
+
+        template<typename T1, typename T2>
+        inline constexpr bool contains(const vec2<T1>& p, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(contains, p, o);
+            return JNF_GEOMETRY_RESULT(false);
+        }
+
+        template<typename T1, typename T2>
+        inline constexpr bool contains(const line<T1>& l, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(contains, l, o);
+            return JNF_GEOMETRY_RESULT(false);
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const rect<T1>& r, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(contains, r, o);
+            return JNF_GEOMETRY_RESULT(contains(r, o.corner(0))
+                    && contains(r, o.corner(1)) && contains(r, o.corner(2))
+                    && contains(r, o.corner(3)));
+        }
+
+        template<typename T1, typename T2>
+        inline bool contains(const circle<T1>& c, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(contains, c, o);
+            return JNF_GEOMETRY_RESULT(contains(c, o.corner(0))
+                    && contains(c, o.corner(1)) && contains(c, o.corner(2))
+                    && contains(c, o.corner(3)));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const obb<T1>& o, const vec2<T2>& p) {
+            JNF_GEOMETRY_PROBE(overlaps, o, p);
+            return JNF_GEOMETRY_RESULT(contains(o, p));
+        }
+
+        // True for a segment wholly inside the box as well, unlike
+        // overlaps(rect, line).
+        template<typename T1, typename T2>
+        inline bool overlaps(const obb<T1>& o, const line<T2>& l) {
+            JNF_GEOMETRY_PROBE(overlaps, o, l);
+            return JNF_GEOMETRY_RESULT(detail::sat(o, l));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const obb<T1>& o, const rect<T2>& r) {
+            JNF_GEOMETRY_PROBE(overlaps, o, r);
+            return JNF_GEOMETRY_RESULT(detail::sat(o, obb<T2>(r)));
+        }
+
+        // True for a circle touching the box, whereas overlaps(circle,
+        // rect) and overlaps(circle, line) need it to reach inside.
+        template<typename T1, typename T2>
+        inline bool overlaps(const obb<T1>& o, const circle<T2>& c) {
+            JNF_GEOMETRY_PROBE(overlaps, o, c);
+            const auto q = o.local(c.center);
+            const auto d = q - q.clamp(-o.half, o.half);
+            return JNF_GEOMETRY_RESULT(d.mag2() <= c.radius * c.radius);
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const obb<T1>& o1, const obb<T2>& o2) {
+            JNF_GEOMETRY_PROBE(overlaps, o1, o2);
+            return JNF_GEOMETRY_RESULT(detail::sat(o1, o2));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const vec2<T1>& p, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(overlaps, p, o);
+            return JNF_GEOMETRY_RESULT(overlaps(o, p));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const line<T1>& l, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(overlaps, l, o);
+            return JNF_GEOMETRY_RESULT(overlaps(o, l));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const rect<T1>& r, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(overlaps, r, o);
+            return JNF_GEOMETRY_RESULT(overlaps(o, r));
+        }
+
+        template<typename T1, typename T2>
+        inline bool overlaps(const circle<T1>& c, const obb<T2>& o) {
+            JNF_GEOMETRY_PROBE(overlaps, c, o);
+            return JNF_GEOMETRY_RESULT(overlaps(o, c));
+        }
+
+        namespace detail {
+            // Boundary crossings of the box sides with another shape, found
+            // through g(side, visitor) for each side in turn.
+            template<typename T, typename F, typename G>
+            inline bool sides(const obb<T>& o, F& f, bool& hit, G&& g) {
+                for (auto i = 0; i < 4; ++i) {
+                    const bool more = g(o.side(i), [&f, &hit](const auto& p) {
+                        hit = true;
+                        return detail::visit(f, p);
+                    });
+                    if (!more) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Early rejects of the intersects overloads below.
+            template<typename T1, typename T2>
+            inline bool apart(const obb<T1>& o, const line<T2>& l) {
+                return !sat(o, l);
+            }
+
+            template<typename T1, typename T2>
+            inline bool apart(const obb<T1>& o, const rect<T2>& r) {
+                return !sat(o, obb<T2>(r));
+            }
+
+            template<typename T1, typename T2>
+            inline bool apart(const obb<T1>& o, const circle<T2>& c) {
+                return !overlaps(o, c);
+            }
+
+            template<typename T1, typename T2>
+            inline bool apart(const obb<T1>& o1, const obb<T2>& o2) {
+                return !sat(o1, o2);
+            }
+
+            // Crossings of one side of a box with another shape.
+            template<typename T1, typename T2, typename F>
+            inline bool side_crossings(const line<T1>& s, const line<T2>& l,
+                    F& f) {
+                return intersects(s, l, f);
+            }
+
+            template<typename T1, typename T2, typename F>
+            inline bool side_crossings(const line<T1>& s, const rect<T2>& r,
+                    F& f) {
+                for (auto j = 0; j < 4; ++j) {
+                    if (!intersects(s, r.side(j), f)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            template<typename T1, typename T2, typename F>
+            inline bool side_crossings(const line<T1>& s,
+                    const circle<T2>& c, F& f) {
+                return intersects(c, s, f);
+            }
+
+            template<typename T1, typename T2, typename F>
+            inline bool side_crossings(const line<T1>& s, const obb<T2>& o,
+                    F& f) {
+                for (auto j = 0; j < 4; ++j) {
+                    if (!intersects(s, o.side(j), f)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const obb<T1>& o, const vec2<T2>& p, F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, o, p);
+            if (contains(o.side(0), p) || contains(o.side(1), p)
+                    || contains(o.side(2), p) || contains(o.side(3), p)) {
+                JNF_GEOMETRY_HIT(true);
+                return detail::visit(f, p);
+            }
+            return true;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const obb<T1>& o, const vec2<T2>& p,
+                const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(o, p, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const obb<T1>& o, const line<T2>& l, F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, o, l);
+            if (detail::apart(o, l)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::sides(o, f, hit,
+                    [&l](const line<T1>& s, auto&& g) {
+                return detail::side_crossings(s, l, g);
+            });
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const obb<T1>& o, const line<T2>& l,
+                const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(o, l, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const obb<T1>& o, const rect<T2>& r, F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, o, r);
+            if (detail::apart(o, r)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::sides(o, f, hit,
+                    [&r](const line<T1>& s, auto&& g) {
+                return detail::side_crossings(s, r, g);
+            });
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const obb<T1>& o, const rect<T2>& r,
+                const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(o, r, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const obb<T1>& o, const circle<T2>& c,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, o, c);
+            if (detail::apart(o, c)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::sides(o, f, hit,
+                    [&c](const line<T1>& s, auto&& g) {
+                return detail::side_crossings(s, c, g);
+            });
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const obb<T1>& o,
+                const circle<T2>& c, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(o, c, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const obb<T1>& o1, const obb<T2>& o2, F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, o1, o2);
+            if (detail::apart(o1, o2)) {
+                JNF_GEOMETRY_REJECT();
+                return true;
+            }
+            bool hit = false;
+            const bool more = detail::sides(o1, f, hit,
+                    [&o2](const line<T1>& s, auto&& g) {
+                return detail::side_crossings(s, o2, g);
+            });
+            JNF_GEOMETRY_HIT(hit);
+            return more;
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const obb<T1>& o1,
+                const obb<T2>& o2, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(o1, o2, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const vec2<T1>& p, const obb<T2>& o, F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, p, o);
+            return intersects(o, p, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const vec2<T1>& p, const obb<T2>& o,
+                const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(p, o, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const line<T1>& l, const obb<T2>& o, F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, l, o);
+            return intersects(o, l, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const line<T1>& l, const obb<T2>& o,
+                const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(l, o, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const rect<T1>& r, const obb<T2>& o, F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, r, o);
+            return intersects(o, r, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const rect<T1>& r, const obb<T2>& o,
+                const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(r, o, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T1, typename T2, detail::visitor<vec2<T2>> F>
+        inline bool intersects(const circle<T1>& c, const obb<T2>& o,
+                F&& f) {
+            JNF_GEOMETRY_PROBE(intersects, c, o);
+            return intersects(o, c, f);
+        }
+
+        template<typename T1, typename T2,
+                detail::allocator A = std::allocator<vec2<T2>>>
+        inline points<T2, A> intersects(const circle<T1>& c,
+                const obb<T2>& o, const A& alloc = A()) {
+            points<T2, A> ret(alloc);
+            intersects(c, o, [&ret](const vec2<T2>& p) {
+                ret.push_back(p);
+            });
+            return ret;
+        }
+
+        template<typename T>
+        inline circle<T> envelope_c(const obb<T>& o) {
+            return circle<T>(o.center, o.half.mag());
+        }
+
+        template<typename T>
+        inline rect<T> envelope_r(const obb<T>& o) {
+            const vec2<T> e(o.extent({T(1), T(0)}), o.extent({T(0), T(1)}));
+            return rect<T>(o.center - e, e * T(2));
+        }
+
+        namespace detail {
+            template <typename T>
+            struct scalar<obb<T>> {
+                using type = T;
+            };
+
+            // intersection_generator walks a box side by side, like the
+            // intersects overloads above.
+            template <typename T, typename S, std::int32_t N>
+            struct obb_parts {
+                static constexpr std::int32_t count = 4;
+                static constexpr std::int32_t size = N;
+
+                template <typename F>
+                static inline bool visit(const obb<T>& o, const S& s,
+                        const std::int32_t k, F& f) {
+                    if (k == 0 && apart(o, s)) {
+                        return false;
+                    }
+                    side_crossings(o.side(k), s, f);
+                    return true;
+                }
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<obb<T1>, vec2<T2>> {
+                static constexpr std::int32_t count = 4;
+                static constexpr std::int32_t size = 1;
+
+                template <typename F>
+                static inline bool visit(const obb<T1>& o, const vec2<T2>& p,
+                        const std::int32_t k, F& f) {
+                    if (!contains(o.side(k), p)) {
+                        return true;
+                    }
+                    detail::visit(f, p);
+                    return false;
+                }
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<obb<T1>, line<T2>>
+                    : obb_parts<T1, line<T2>, 1> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<obb<T1>, rect<T2>>
+                    : obb_parts<T1, rect<T2>, 4> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<obb<T1>, circle<T2>>
+                    : obb_parts<T1, circle<T2>, 2> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<obb<T1>, obb<T2>>
+                    : obb_parts<T1, obb<T2>, 4> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<vec2<T1>, obb<T2>>
+                    : mirrored_parts<lazy_parts<obb<T2>, vec2<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<line<T1>, obb<T2>>
+                    : mirrored_parts<lazy_parts<obb<T2>, line<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<rect<T1>, obb<T2>>
+                    : mirrored_parts<lazy_parts<obb<T2>, rect<T1>>> {
+            };
+
+            template <typename T1, typename T2>
+            struct lazy_parts<circle<T1>, obb<T2>>
+                    : mirrored_parts<lazy_parts<obb<T2>, circle<T1>>> {
+            };
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_OBB_H
@@ -0,0 +1,229 @@
+#ifndef JNF_GEOMETRY_OCCUPANCY_H
+#define JNF_GEOMETRY_OCCUPANCY_H
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "jnf_geometry.h"
+
+// Conservative occupancy bitmap. Shapes are rasterized into a grid of one bit
+// per cell, marking every cell a shape touches, rows packed into 64-bit
+// words. A new shape is tested by rasterizing it the same way and ANDing its
+// row spans with the bitmap a word at a time: no common bit proves that it
+// overlaps none of the shapes added so far, so the exact overlaps() tests can
+// be skipped. A common bit only means the shapes may overlap.
+//
+// Each row of a shape is covered by a single span of cells, from the leftmost
+// to the rightmost point of the shape within the row, so rects, circles and
+// lines are rasterized exactly up to the cells. Other shapes go through their
+// envelope_r. Shapes reaching past the grid bounds are clamped onto its
+// border cells, which keeps the test conservative at the cost of precision
+// there.
+
+namespace jnf {
+    namespace geometry {
+        template <typename T>
+        class occupancy_grid {
+        public:
+            inline explicit occupancy_grid(const rect<T>& bounds = rect<T>(),
+                    const T cell = T(1)) : bounds_(bounds), cell_(cell) {
+                const auto cols = std::ceil(double(bounds.size.x) / cell);
+                const auto rows = std::ceil(double(bounds.size.y) / cell);
+                cols_ = static_cast<std::uint32_t>(std::max(cols, 1.0));
+                rows_ = static_cast<std::uint32_t>(std::max(rows, 1.0));
+                stride_ = (cols_ + 63) / 64;
+                words_.assign(std::size_t(stride_) * rows_, 0);
+            }
+
+            template <typename S>
+            inline void rasterize(const S& shape) {
+                spans(shape, [this](const std::uint32_t row,
+                        const std::uint32_t x0, const std::uint32_t x1) {
+                    auto* w = words_.data() + std::size_t(row) * stride_;
+                    for (auto i = x0 / 64; i <= x1 / 64; ++i) {
+                        w[i] |= mask(i, x0, x1);
+                    }
+                    return true;
+                });
+            }
+
+            // False if the shape cannot overlap any rasterized shape.
+            template <typename S>
+            inline bool maybe_overlaps(const S& shape) const {
+                bool hit = false;
+                spans(shape, [this, &hit](const std::uint32_t row,
+                        const std::uint32_t x0, const std::uint32_t x1) {
+                    const auto* w = words_.data() + std::size_t(row) * stride_;
+                    for (auto i = x0 / 64; i <= x1 / 64; ++i) {
+                        if ((w[i] & mask(i, x0, x1)) != 0) {
+                            hit = true;
+                            return false;
+                        }
+                    }
+                    return true;
+                });
+                return hit;
+            }
+
+            inline void clear() {
+                std::fill(words_.begin(), words_.end(), 0);
+            }
+
+            // Number of occupied cells.
+            inline std::size_t count() const {
+                std::size_t n = 0;
+                for (const auto w : words_) {
+                    n += static_cast<std::size_t>(std::popcount(w));
+                }
+                return n;
+            }
+
+            inline bool occupied(const std::uint32_t col,
+                    const std::uint32_t row) const {
+                return (words_[std::size_t(row) * stride_ + col / 64]
+                        >> (col % 64) & 1) != 0;
+            }
+
+            inline std::uint32_t cols() const {
+                return cols_;
+            }
+
+            inline std::uint32_t rows() const {
+                return rows_;
+            }
+
+            inline const rect<T>& bounds() const {
+                return bounds_;
+            }
+
+        private:
+            rect<T> bounds_;
+            T cell_;
+            std::uint32_t cols_;
+            std::uint32_t rows_;
+            std::uint32_t stride_;
+            std::vector<std::uint64_t> words_;
+
+            // Bits of word i that fall in columns [x0, x1].
+            static inline std::uint64_t mask(const std::uint32_t i,
+                    const std::uint32_t x0, const std::uint32_t x1) {
+                const auto lo = i == x0 / 64 ? x0 % 64 : 0u;
+                const auto hi = i == x1 / 64 ? x1 % 64 : 63u;
+                const auto top = hi == 63 ? ~0ull : (1ull << (hi + 1)) - 1;
+                return top & ~((1ull << lo) - 1);
+            }
+
+            // Column or row of a coordinate, clamped onto the grid.
+            inline std::uint32_t index(const double v, const double lo,
+                    const std::uint32_t n) const {
+                const auto c = std::floor((v - lo) / cell_);
+                return static_cast<std::uint32_t>(
+                        std::clamp(c, 0.0, double(n - 1)));
+            }
+
+            inline std::uint32_t col(const double x) const {
+                return index(x, bounds_.pos.x, cols_);
+            }
+
+            inline std::uint32_t row(const double y) const {
+                return index(y, bounds_.pos.y, rows_);
+            }
+
+            // The y range of a row, unbounded beyond the border rows so that
+            // clamped parts of a shape land on them.
+            inline std::pair<double, double> band(const std::uint32_t r) const {
+                const double y = bounds_.pos.y + double(r) * cell_;
+                return {r == 0 ? -INFINITY : y,
+                        r == rows_ - 1 ? INFINITY : y + cell_};
+            }
+
+            // Passes the columns covering [x0, x1] in row r to f, widened by
+            // a sliver of a cell so that rounding cannot drop a cell the
+            // shape only just reaches. The spans() overloads call f(row, c0,
+            // c1) for each row of a shape until f returns false.
+            template <typename F>
+            inline bool emit(const std::uint32_t r, const double x0,
+                    const double x1, F& f) const {
+                const auto e = cell_ * 1e-6;
+                return f(r, col(x0 - e), col(x1 + e));
+            }
+
+            template <typename F>
+            inline void spans(const rect<T>& r, F&& f) const {
+                const auto e = cell_ * 1e-6;
+                const double x0 = r.pos.x;
+                const double x1 = double(r.pos.x) + r.size.x;
+                for (auto y = row(r.pos.y - e),
+                        y1 = row(double(r.pos.y) + r.size.y + e);
+                        y <= y1; ++y) {
+                    if (!emit(y, x0, x1, f)) {
+                        return;
+                    }
+                }
+            }
+
+            template <typename F>
+            inline void spans(const circle<T>& c, F&& f) const {
+                const auto e = cell_ * 1e-6;
+                const double cx = c.center.x;
+                const double cy = c.center.y;
+                const double r = c.radius;
+                for (auto y = row(cy - r - e), y1 = row(cy + r + e); y <= y1;
+                        ++y) {
+                    // Widest chord of the circle within the row.
+                    const auto [ya, yb] = band(y);
+                    const auto dy = cy < ya ? ya - cy : cy > yb ? cy - yb : 0.0;
+                    const auto h = std::sqrt(std::max(r * r - dy * dy, 0.0));
+                    if (!emit(y, cx - h, cx + h, f)) {
+                        return;
+                    }
+                }
+            }
+
+            template <typename F>
+            inline void spans(const line<T>& l, F&& f) const {
+                const auto e = cell_ * 1e-6;
+                const vec2<double> a(l.start.x, l.start.y);
+                const vec2<double> b(l.end.x, l.end.y);
+                const auto d = b - a;
+                for (auto y = row(std::min(a.y, b.y) - e),
+                        y1 = row(std::max(a.y, b.y) + e); y <= y1; ++y) {
+                    // The part of the segment within the row.
+                    auto t0 = 0.0;
+                    auto t1 = 1.0;
+                    if (d.y != 0) {
+                        const auto [ya, yb] = band(y);
+                        const auto u0 = (ya - a.y) / d.y;
+                        const auto u1 = (yb - a.y) / d.y;
+                        t0 = std::max(t0, std::min(u0, u1));
+                        t1 = std::min(t1, std::max(u0, u1));
+                        // Rows only grazed because of the widening get the
+                        // nearest point of the segment.
+                        t0 = std::clamp(t0, 0.0, 1.0);
+                        t1 = std::clamp(t1, 0.0, 1.0);
+                        if (t0 > t1) {
+                            std::swap(t0, t1);
+                        }
+                    }
+                    const auto xa = a.x + d.x * t0;
+                    const auto xb = a.x + d.x * t1;
+                    if (!emit(y, std::min(xa, xb), std::max(xa, xb), f)) {
+                        return;
+                    }
+                }
+            }
+
+            template <typename S, typename F>
+            inline void spans(const S& shape, F&& f) const {
+                spans(envelope_r(shape), f);
+            }
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_OCCUPANCY_H
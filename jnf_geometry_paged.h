@@ -0,0 +1,668 @@
+#ifndef JNF_GEOMETRY_PAGED_H
+#define JNF_GEOMETRY_PAGED_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_mmap.h"
+#include "jnf_geometry_morton.h"
+
+// Out-of-core R-tree over rect or line features. The tree is bulk loaded into
+// a file of fixed-size pages: the features are ordered along a Z-order curve
+// of their envelope centers with an external merge sort bounded by a memory
+// budget, packed into full leaf pages in that order, and the levels above are
+// packed the same way from the level below. Leaves therefore come first in
+// the file and each level follows the one beneath it, ending with the root.
+//
+// The reader maps the file and keeps the small upper levels resident. Leaf
+// pages are tracked by a CLOCK cache of bounded size; evicted pages are handed
+// back to the kernel so that the resident set stays bounded. Queries descend
+// one level at a time and visit the pages of a level in file order, reading
+// ahead over runs of neighbouring pages.
+
+namespace jnf {
+    namespace geometry {
+        namespace detail {
+            inline constexpr char paged_magic[8] = {
+                'J', 'N', 'F', 'R', 'T', 'R', 'E', 'E'
+            };
+
+            constexpr std::uint32_t paged_version = 1;
+
+            struct paged_header {
+                char magic[8];
+                std::uint32_t version;
+                std::uint32_t page_size;
+                std::uint32_t scalar;
+                std::uint32_t shape;
+                std::uint64_t count;
+                std::uint64_t pages;
+                std::uint64_t leaves;
+                std::uint64_t root;
+                std::uint32_t height;
+                std::uint32_t reserved;
+                double bounds[4];
+            };
+
+            struct paged_node {
+                std::uint32_t level;
+                std::uint32_t count;
+            };
+
+            template <typename S>
+            struct paged_leaf {
+                S shape;
+                std::uint64_t id;
+            };
+
+            template <typename T>
+            struct paged_branch {
+                rect<T> box;
+                std::uint64_t page;
+            };
+
+            // Feature type tag stored in the header next to the scalar tag.
+            template <typename S>
+            inline constexpr std::uint32_t paged_shape() {
+                return is_rect_v<S> ? 1 : 2;
+            }
+
+            // Closed leaf filter matching the closed branch test: a segment
+            // wholly inside the window reaches it without crossing a side.
+            template <typename T>
+            inline bool reaches(const rect<T>& r, const rect<T>& window) {
+                return meets(r, window);
+            }
+
+            template <typename T>
+            inline bool reaches(const line<T>& l, const rect<T>& window) {
+                if (!meets(envelope_r(l), window)) {
+                    return false;
+                }
+                const auto& p = l.start;
+                const auto q = window.pos + window.size;
+                return (p.x >= window.pos.x && p.x <= q.x
+                        && p.y >= window.pos.y && p.y <= q.y)
+                        || overlaps(window, l);
+            }
+
+            // CLOCK replacement over page numbers.
+            class page_cache {
+            public:
+                static constexpr std::uint64_t none = ~std::uint64_t(0);
+
+                inline explicit page_cache(const std::size_t capacity)
+                        : capacity_(std::max<std::size_t>(capacity, 1)) {
+                }
+
+                // Marks the page as used and returns whether it had to be
+                // admitted; evicted is set to the page that made room for it,
+                // if any.
+                inline bool touch(const std::uint64_t page,
+                        std::uint64_t& evicted) {
+                    evicted = none;
+                    const auto it = slots_.find(page);
+                    if (it != slots_.end()) {
+                        used_[it->second] = true;
+                        return false;
+                    }
+                    if (pages_.size() < capacity_) {
+                        slots_.emplace(page, pages_.size());
+                        pages_.push_back(page);
+                        used_.push_back(true);
+                        return true;
+                    }
+                    while (used_[hand_]) {
+                        used_[hand_] = false;
+                        hand_ = (hand_ + 1) % capacity_;
+                    }
+                    evicted = pages_[hand_];
+                    slots_.erase(evicted);
+                    slots_.emplace(page, hand_);
+                    pages_[hand_] = page;
+                    used_[hand_] = true;
+                    hand_ = (hand_ + 1) % capacity_;
+                    return true;
+                }
+
+                inline void clear() {
+                    slots_.clear();
+                    pages_.clear();
+                    used_.clear();
+                    hand_ = 0;
+                }
+
+            private:
+                std::size_t capacity_;
+                std::unordered_map<std::uint64_t, std::size_t> slots_;
+                std::vector<std::uint64_t> pages_;
+                std::vector<bool> used_;
+                std::size_t hand_ = 0;
+            };
+        }
+
+        // Writes a paged R-tree over features of type S (rect<T> or line<T>).
+        // Features are buffered up to the memory budget and spilled to
+        // temporary files beyond it, so the input may exceed main memory.
+        template <typename S>
+        class paged_rtree_builder {
+        public:
+            using value_type = detail::scalar_t<S>;
+
+            static_assert(detail::is_rect_v<S> || detail::is_line_v<S>,
+                    "paged_rtree stores rect or line features");
+
+            inline explicit paged_rtree_builder(
+                    const std::size_t memory = std::size_t(64) << 20,
+                    const std::uint32_t page_size = 4096)
+                    : capacity_(std::max<std::size_t>(
+                    memory / sizeof(record), 1024)), page_size_(page_size) {
+            }
+
+            paged_rtree_builder(const paged_rtree_builder&) = delete;
+
+            paged_rtree_builder& operator=(const paged_rtree_builder&) = delete;
+
+            inline ~paged_rtree_builder() {
+                if (raw_ != nullptr) {
+                    std::fclose(raw_);
+                }
+            }
+
+            inline void add(const std::uint64_t id, const S& shape) {
+                const auto box = envelope_r(shape);
+                lo_ = lo_.min(vec2<double>(box.pos.x, box.pos.y));
+                hi_ = hi_.max(vec2<double>(box.pos.x + box.size.x,
+                        box.pos.y + box.size.y));
+                buffer_.push_back(record{0, {shape, id}});
+                ++count_;
+                if (buffer_.size() == capacity_) {
+                    spill();
+                }
+            }
+
+            inline std::uint64_t size() const {
+                return count_;
+            }
+
+            // Sorts, packs and writes the tree; returns false on I/O errors.
+            // The builder is spent afterwards.
+            inline bool write(const std::string& path) {
+                if (page_size_ < sizeof(detail::paged_header)
+                        || leaf_capacity() < 2 || branch_capacity() < 2) {
+                    return false;
+                }
+                out_ = std::fopen(path.c_str(), "wb");
+                if (out_ == nullptr) {
+                    return false;
+                }
+                page_.assign(page_size_, std::byte(0));
+                ok_ = std::fwrite(page_.data(), 1, page_size_, out_)
+                        == page_size_;
+                pages_ = 1;
+                level_ = std::tmpfile();
+                ok_ = ok_ && level_ != nullptr;
+                if (ok_) {
+                    if (raw_ == nullptr) {
+                        keys(buffer_.data(), buffer_.size());
+                        for (const auto& r : buffer_) {
+                            leaf(r.e);
+                        }
+                    } else {
+                        merge();
+                    }
+                    flush_leaf();
+                }
+                const auto leaves = pages_ - 1;
+                std::uint32_t height = count_ == 0 ? 0 : 1;
+                for (auto n = leaves; ok_ && n > 1; ++height) {
+                    n = pack_level(n, height);
+                }
+                detail::paged_header h{};
+                std::memcpy(h.magic, detail::paged_magic, sizeof(h.magic));
+                h.version = detail::paged_version;
+                h.page_size = page_size_;
+                h.scalar = detail::scalar_tag<value_type>();
+                h.shape = detail::paged_shape<S>();
+                h.count = count_;
+                h.pages = pages_;
+                h.leaves = leaves;
+                h.root = count_ == 0 ? 0 : pages_ - 1;
+                h.height = height;
+                h.bounds[0] = lo_.x;
+                h.bounds[1] = lo_.y;
+                h.bounds[2] = hi_.x;
+                h.bounds[3] = hi_.y;
+                ok_ = ok_ && std::fseek(out_, 0, SEEK_SET) == 0
+                        && std::fwrite(&h, sizeof(h), 1, out_) == 1;
+                ok_ = std::fclose(out_) == 0 && ok_;
+                out_ = nullptr;
+                if (level_ != nullptr) {
+                    std::fclose(level_);
+                    level_ = nullptr;
+                }
+                buffer_.clear();
+                buffer_.shrink_to_fit();
+                return ok_;
+            }
+
+        private:
+            using leaf_entry = detail::paged_leaf<S>;
+            using branch_entry = detail::paged_branch<value_type>;
+
+            struct record {
+                std::uint64_t key;
+                leaf_entry e;
+            };
+
+            struct run {
+                std::uint64_t next;
+                std::uint64_t end;
+                std::vector<record> buf;
+                std::size_t pos = 0;
+            };
+
+            std::size_t capacity_;
+            std::uint32_t page_size_;
+            std::vector<record> buffer_;
+            std::uint64_t count_ = 0;
+            vec2<double> lo_{INFINITY, INFINITY};
+            vec2<double> hi_{-INFINITY, -INFINITY};
+            std::FILE* raw_ = nullptr;
+            std::FILE* out_ = nullptr;
+            std::FILE* level_ = nullptr;
+            std::vector<std::byte> page_;
+            std::vector<leaf_entry> node_;
+            std::uint64_t pages_ = 0;
+            bool ok_ = true;
+
+            inline std::size_t leaf_capacity() const {
+                return (page_size_ - sizeof(detail::paged_node))
+                        / sizeof(leaf_entry);
+            }
+
+            inline std::size_t branch_capacity() const {
+                return (page_size_ - sizeof(detail::paged_node))
+                        / sizeof(branch_entry);
+            }
+
+            inline void spill() {
+                if (raw_ == nullptr) {
+                    raw_ = std::tmpfile();
+                    ok_ = ok_ && raw_ != nullptr;
+                }
+                if (raw_ != nullptr) {
+                    ok_ = ok_ && std::fwrite(buffer_.data(), sizeof(record),
+                            buffer_.size(), raw_) == buffer_.size();
+                }
+                buffer_.clear();
+            }
+
+            // Z-order keys of the envelope centers over the final bounds,
+            // which are only known once every feature has been added.
+            inline void keys(record* rs, const std::size_t n) const {
+                const auto span = hi_ - lo_;
+                const double q = 4294967295.0;
+                const vec2<double> scale(span.x > 0 ? q / span.x : 0,
+                        span.y > 0 ? q / span.y : 0);
+                for (std::size_t i = 0; i < n; ++i) {
+                    const auto b = envelope_r(rs[i].e.shape);
+                    const auto x = (b.pos.x + b.size.x * 0.5 - lo_.x)
+                            * scale.x;
+                    const auto y = (b.pos.y + b.size.y * 0.5 - lo_.y)
+                            * scale.y;
+                    rs[i].key = detail::spread(static_cast<std::uint64_t>(
+                            std::clamp(x, 0.0, q)))
+                            | (detail::spread(static_cast<std::uint64_t>(
+                            std::clamp(y, 0.0, q))) << 1);
+                }
+                std::sort(rs, rs + n, [](const record& a, const record& b) {
+                    return a.key < b.key
+                            || (a.key == b.key && a.e.id < b.e.id);
+                });
+            }
+
+            // Sorts the spilled input into runs of at most capacity_ records
+            // and merges them into the leaf level.
+            inline void merge() {
+                spill();
+                buffer_.resize(capacity_);
+                std::FILE* runs = std::tmpfile();
+                ok_ = ok_ && runs != nullptr && std::fflush(raw_) == 0;
+                std::rewind(raw_);
+                std::vector<run> rs;
+                std::uint64_t at = 0;
+                while (ok_) {
+                    const auto n = std::fread(buffer_.data(), sizeof(record),
+                            capacity_, raw_);
+                    if (n == 0) {
+                        break;
+                    }
+                    keys(buffer_.data(), n);
+                    ok_ = std::fwrite(buffer_.data(), sizeof(record), n, runs)
+                            == n;
+                    rs.push_back(run{at, at + n, {}, 0});
+                    at += n;
+                }
+                std::fclose(raw_);
+                raw_ = nullptr;
+                buffer_.clear();
+                buffer_.shrink_to_fit();
+                if (!ok_) {
+                    if (runs != nullptr) {
+                        std::fclose(runs);
+                    }
+                    return;
+                }
+                const auto per_run = std::max<std::size_t>(
+                        capacity_ / std::max<std::size_t>(rs.size(), 1), 64);
+                const auto fill = [this, runs, per_run](run& r) {
+                    const auto n = static_cast<std::size_t>(std::min<
+                            std::uint64_t>(per_run, r.end - r.next));
+                    r.buf.resize(n);
+                    r.pos = 0;
+                    ok_ = ok_ && std::fseek(runs, static_cast<long>(
+                            r.next * sizeof(record)), SEEK_SET) == 0
+                            && std::fread(r.buf.data(), sizeof(record), n,
+                            runs) == n;
+                    r.next += n;
+                };
+                const auto later = [&rs](const std::size_t a,
+                        const std::size_t b) {
+                    const auto& x = rs[a].buf[rs[a].pos];
+                    const auto& y = rs[b].buf[rs[b].pos];
+                    return x.key > y.key
+                            || (x.key == y.key && x.e.id > y.e.id);
+                };
+                std::priority_queue<std::size_t, std::vector<std::size_t>,
+                        decltype(later)> heap(later);
+                for (std::size_t i = 0; i < rs.size(); ++i) {
+                    fill(rs[i]);
+                    if (!rs[i].buf.empty()) {
+                        heap.push(i);
+                    }
+                }
+                while (ok_ && !heap.empty()) {
+                    const auto i = heap.top();
+                    heap.pop();
+                    auto& r = rs[i];
+                    leaf(r.buf[r.pos].e);
+                    if (++r.pos == r.buf.size()) {
+                        fill(r);
+                    }
+                    if (r.pos < r.buf.size()) {
+                        heap.push(i);
+                    }
+                }
+                std::fclose(runs);
+            }
+
+            template <typename E>
+            inline void write_node(const std::uint32_t level, const E* es,
+                    const std::size_t n) {
+                std::fill(page_.begin(), page_.end(), std::byte(0));
+                const detail::paged_node h{level,
+                        static_cast<std::uint32_t>(n)};
+                std::memcpy(page_.data(), &h, sizeof(h));
+                std::memcpy(page_.data() + sizeof(h), es, n * sizeof(E));
+                ok_ = ok_ && std::fwrite(page_.data(), 1, page_size_, out_)
+                        == page_size_;
+                ++pages_;
+            }
+
+            inline void parent(std::FILE* f, const rect<value_type>& box) {
+                const branch_entry e{box, pages_ - 1};
+                ok_ = ok_ && std::fwrite(&e, sizeof(e), 1, f) == 1;
+            }
+
+            inline void leaf(const leaf_entry& e) {
+                node_.push_back(e);
+                if (node_.size() == leaf_capacity()) {
+                    flush_leaf();
+                }
+            }
+
+            inline void flush_leaf() {
+                if (node_.empty()) {
+                    return;
+                }
+                auto box = envelope_r(node_[0].shape);
+                for (const auto& e : node_) {
+                    box = envelope_r(box, envelope_r(e.shape));
+                }
+                write_node(0, node_.data(), node_.size());
+                parent(level_, box);
+                node_.clear();
+            }
+
+            // Packs the n entries of level_ into nodes of the given level and
+            // leaves their parent entries in level_; returns their count.
+            inline std::uint64_t pack_level(const std::uint64_t n,
+                    const std::uint32_t level) {
+                std::FILE* next = std::tmpfile();
+                ok_ = ok_ && next != nullptr && std::fflush(level_) == 0;
+                std::rewind(level_);
+                std::vector<branch_entry> es(branch_capacity());
+                std::uint64_t parents = 0;
+                for (std::uint64_t done = 0; ok_ && done < n; ++parents) {
+                    const auto k = static_cast<std::size_t>(std::min<
+                            std::uint64_t>(es.size(), n - done));
+                    ok_ = std::fread(es.data(), sizeof(branch_entry), k,
+                            level_) == k;
+                    auto box = es[0].box;
+                    for (std::size_t i = 1; i < k; ++i) {
+                        box = envelope_r(box, es[i].box);
+                    }
+                    write_node(level, es.data(), k);
+                    parent(next, box);
+                    done += k;
+                }
+                std::fclose(level_);
+                level_ = next;
+                return parents;
+            }
+        };
+
+        // Read side of a file written by paged_rtree_builder<S>. Not safe for
+        // concurrent queries, since they update the page cache; open the file
+        // once per thread instead, the mapping being shared by the kernel.
+        template <typename S>
+        class paged_rtree {
+        public:
+            using value_type = detail::scalar_t<S>;
+
+            struct statistics {
+                std::uint64_t touched = 0;
+                std::uint64_t admitted = 0;
+                std::uint64_t evicted = 0;
+            };
+
+            // cache_pages bounds the number of leaf pages kept resident.
+            inline explicit paged_rtree(
+                    const std::size_t cache_pages = std::size_t(1) << 16)
+                    : cache_(cache_pages) {
+            }
+
+            inline bool open(const std::string& path) {
+                file_.close();
+                cache_.clear();
+                header_ = detail::paged_header{};
+                if (!file_.open(path)
+                        || file_.size() < sizeof(detail::paged_header)) {
+                    file_.close();
+                    return false;
+                }
+                std::memcpy(&header_, file_.data(), sizeof(header_));
+                if (std::memcmp(header_.magic, detail::paged_magic,
+                        sizeof(header_.magic)) != 0
+                        || header_.version != detail::paged_version
+                        || header_.scalar != detail::scalar_tag<value_type>()
+                        || header_.shape != detail::paged_shape<S>()
+                        || header_.page_size < sizeof(header_)
+                        || file_.size() / header_.page_size < header_.pages) {
+                    file_.close();
+                    header_ = detail::paged_header{};
+                    return false;
+                }
+                const std::size_t ps = header_.page_size;
+                const auto first = 1 + header_.leaves;
+                file_.will_need(first * ps, (header_.pages - first) * ps);
+                return true;
+            }
+
+            inline bool is_open() const {
+                return file_.is_open();
+            }
+
+            inline std::uint64_t size() const {
+                return header_.count;
+            }
+
+            inline std::uint32_t height() const {
+                return header_.height;
+            }
+
+            inline std::uint64_t pages() const {
+                return header_.pages;
+            }
+
+            inline rect<value_type> bounds() const {
+                return rect<value_type>(
+                        {value_type(header_.bounds[0]),
+                        value_type(header_.bounds[1])},
+                        {value_type(header_.bounds[2] - header_.bounds[0]),
+                        value_type(header_.bounds[3] - header_.bounds[1])});
+            }
+
+            inline const statistics& stats() const {
+                return stats_;
+            }
+
+            inline void reset_stats() {
+                stats_ = statistics();
+            }
+
+            // Calls f(id, shape) for every feature meeting the window, edges
+            // included. If f returns bool, returning false stops the query.
+            template <typename F>
+            inline void query(const rect<value_type>& window, F&& f) {
+                if (header_.count == 0) {
+                    return;
+                }
+                frontier_.assign(1, header_.root);
+                for (auto level = header_.height; level-- > 0;) {
+                    std::sort(frontier_.begin(), frontier_.end());
+                    if (level == 0) {
+                        read_ahead();
+                    }
+                    next_.clear();
+                    for (const auto page : frontier_) {
+                        if (level != 0) {
+                            children(page, window);
+                        } else if (!features(page, window, f)) {
+                            return;
+                        }
+                    }
+                    frontier_.swap(next_);
+                }
+            }
+
+            template <typename Q, typename F>
+            inline void query(const Q& shape, F&& f) {
+                query(envelope_r(shape), f);
+            }
+
+        private:
+            using leaf_entry = detail::paged_leaf<S>;
+            using branch_entry = detail::paged_branch<value_type>;
+
+            mapped_file file_;
+            detail::paged_header header_{};
+            detail::page_cache cache_;
+            statistics stats_;
+            std::vector<std::uint64_t> frontier_;
+            std::vector<std::uint64_t> next_;
+
+            inline const std::byte* node(const std::uint64_t page,
+                    detail::paged_node& h) {
+                const auto p = file_.data() + page * header_.page_size;
+                std::memcpy(&h, p, sizeof(h));
+                ++stats_.touched;
+                return p + sizeof(h);
+            }
+
+            // Issues one read-ahead per run of consecutive leaf pages that
+            // are not resident yet.
+            inline void read_ahead() {
+                const std::size_t ps = header_.page_size;
+                std::size_t i = 0;
+                while (i < frontier_.size()) {
+                    auto j = i + 1;
+                    while (j < frontier_.size()
+                            && frontier_[j] == frontier_[j - 1] + 1) {
+                        ++j;
+                    }
+                    if (j - i > 1) {
+                        file_.will_need(frontier_[i] * ps, (j - i) * ps);
+                    }
+                    i = j;
+                }
+            }
+
+            inline void children(const std::uint64_t page,
+                    const rect<value_type>& window) {
+                detail::paged_node h;
+                const auto p = node(page, h);
+                for (std::uint32_t i = 0; i < h.count; ++i) {
+                    branch_entry e;
+                    std::memcpy(&e, p + i * sizeof(e), sizeof(e));
+                    if (detail::meets(e.box, window)) {
+                        next_.push_back(e.page);
+                    }
+                }
+            }
+
+            template <typename F>
+            inline bool features(const std::uint64_t page,
+                    const rect<value_type>& window, F& f) {
+                std::uint64_t evicted;
+                if (cache_.touch(page, evicted)) {
+                    ++stats_.admitted;
+                }
+                if (evicted != detail::page_cache::none) {
+                    ++stats_.evicted;
+                    file_.dont_need(evicted * header_.page_size,
+                            header_.page_size);
+                }
+                detail::paged_node h;
+                const auto p = node(page, h);
+                for (std::uint32_t i = 0; i < h.count; ++i) {
+                    leaf_entry e{S(), 0};
+                    std::memcpy(&e, p + i * sizeof(e), sizeof(e));
+                    if (!detail::reaches(e.shape, window)) {
+                        continue;
+                    }
+                    if constexpr (std::is_void_v<std::invoke_result_t<F&,
+                            std::uint64_t, const S&>>) {
+                        f(e.id, e.shape);
+                    } else if (!f(e.id, e.shape)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_PAGED_H
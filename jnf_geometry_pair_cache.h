@@ -0,0 +1,182 @@
+#ifndef JNF_GEOMETRY_PAIR_CACHE_H
+#define JNF_GEOMETRY_PAIR_CACHE_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+#include "jnf_geometry.h"
+
+namespace jnf {
+    namespace geometry {
+        // Upper bounds on how far any point of a shape has moved between two
+        // states of it (a bound on their Hausdorff distance).
+        template <typename T>
+        inline T drift(const vec2<T>& before, const vec2<T>& after) {
+            return (after - before).mag();
+        }
+
+        template <typename T>
+        inline T drift(const line<T>& before, const line<T>& after) {
+            return std::max(drift(before.start, after.start),
+                    drift(before.end, after.end));
+        }
+
+        template <typename T>
+        inline T drift(const rect<T>& before, const rect<T>& after) {
+            const auto d0 = after.pos - before.pos;
+            const auto d1 = (after.pos + after.size)
+                    - (before.pos + before.size);
+            return vec2<T>(std::max(std::abs(d0.x), std::abs(d1.x)),
+                    std::max(std::abs(d0.y), std::abs(d1.y))).mag();
+        }
+
+        template <typename T>
+        inline T drift(const circle<T>& before, const circle<T>& after) {
+            return drift(before.center, after.center)
+                    + std::abs(after.radius - before.radius);
+        }
+
+        // Frame-to-frame cache of narrowphase results keyed by a pair of shape
+        // ids. A stored result is reused while neither shape has drifted more
+        // than the tolerance from the state it was computed for. A pair that
+        // was apart is moreover known to stay apart as long as the combined
+        // drift is below the gap between their envelopes at that time, so
+        // separated pairs are skipped exactly even when they move more than
+        // the tolerance.
+        template <typename A, typename B>
+        class pair_cache {
+        public:
+            using value_type = decltype(drift(std::declval<const A&>(),
+                    std::declval<const A&>()));
+            using points = decltype(geometry::intersects(
+                    std::declval<const A&>(), std::declval<const B&>()));
+
+            inline explicit pair_cache(
+                    const value_type tolerance = value_type(0))
+                    : tolerance_(tolerance) {
+            }
+
+            inline bool overlaps(const std::uint32_t id_a, const A& a,
+                    const std::uint32_t id_b, const B& b) {
+                auto& e = lookup(id_a, id_b);
+                if (!e.overlaps_valid || !reusable(e, a, b)) {
+                    update(e, a, b);
+                    e.overlaps = geometry::overlaps(e.a, e.b);
+                    e.overlaps_valid = true;
+                    if (!e.overlaps) {
+                        e.gap = distance(envelope_r(e.a), envelope_r(e.b));
+                    }
+                    ++computed_;
+                } else {
+                    ++reused_;
+                }
+                return e.overlaps;
+            }
+
+            inline const points& intersects(const std::uint32_t id_a,
+                    const A& a, const std::uint32_t id_b, const B& b) {
+                auto& e = lookup(id_a, id_b);
+                if (!e.points_valid || !reusable(e, a, b)) {
+                    update(e, a, b);
+                    e.hits = geometry::intersects(e.a, e.b);
+                    e.points_valid = true;
+                    ++computed_;
+                } else {
+                    ++reused_;
+                }
+                return e.hits;
+            }
+
+            // Starts a new frame; entries not queried during the last
+            // max_age frames are dropped.
+            inline void next_frame(const std::uint32_t max_age = 1) {
+                ++frame_;
+                std::erase_if(entries_, [this, max_age](const auto& kv) {
+                    return frame_ - kv.second.frame > max_age;
+                });
+            }
+
+            inline void erase(const std::uint32_t id_a,
+                    const std::uint32_t id_b) {
+                entries_.erase(key(id_a, id_b));
+            }
+
+            inline void clear() {
+                entries_.clear();
+            }
+
+            inline std::size_t size() const {
+                return entries_.size();
+            }
+
+            inline std::uint64_t reused() const {
+                return reused_;
+            }
+
+            inline std::uint64_t computed() const {
+                return computed_;
+            }
+
+        private:
+            struct entry {
+                A a;
+                B b;
+                value_type gap = value_type(0);
+                points hits;
+                std::uint64_t frame = 0;
+                bool overlaps = false;
+                bool overlaps_valid = false;
+                bool points_valid = false;
+            };
+
+            std::unordered_map<std::uint64_t, entry> entries_;
+            value_type tolerance_;
+            std::uint64_t frame_ = 0;
+            std::uint64_t reused_ = 0;
+            std::uint64_t computed_ = 0;
+
+            static inline std::uint64_t key(const std::uint32_t id_a,
+                    const std::uint32_t id_b) {
+                return (static_cast<std::uint64_t>(id_a) << 32) | id_b;
+            }
+
+            inline entry& lookup(const std::uint32_t id_a,
+                    const std::uint32_t id_b) {
+                auto& e = entries_[key(id_a, id_b)];
+                e.frame = frame_;
+                return e;
+            }
+
+            inline bool reusable(const entry& e, const A& a,
+                    const B& b) const {
+                const auto da = drift(e.a, a);
+                const auto db = drift(e.b, b);
+                if (da <= tolerance_ && db <= tolerance_) {
+                    return true;
+                }
+                return e.overlaps_valid && !e.overlaps && da + db < e.gap;
+            }
+
+            // Stores the shapes unless the stored ones are still within
+            // tolerance, so that the results of a pair always describe one
+            // state: the other result is only dropped when the shapes are
+            // replaced. Results are computed for the stored shapes.
+            inline void update(entry& e, const A& a, const B& b) {
+                if ((e.overlaps_valid || e.points_valid)
+                        && drift(e.a, a) <= tolerance_
+                        && drift(e.b, b) <= tolerance_) {
+                    return;
+                }
+                e.a = a;
+                e.b = b;
+                e.overlaps_valid = false;
+                e.points_valid = false;
+            }
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_PAIR_CACHE_H
@@ -0,0 +1,169 @@
+#ifndef JNF_GEOMETRY_PAIRS_H
+#define JNF_GEOMETRY_PAIRS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "jnf_geometry_parallel.h"
+
+// Flat storage for the index pairs produced by the broadphases. A pair_list
+// keeps the two indices of its pairs in separate arrays, so a solver pass
+// that only needs one side, or gathers both sides into its own arrays,
+// streams through contiguous uint32 data. Clearing keeps the capacity: a
+// buffer that lives across frames stops allocating once the pair counts
+// settle.
+
+namespace jnf {
+    namespace geometry {
+        using index_pair = std::pair<std::uint32_t, std::uint32_t>;
+
+        class pair_list {
+        public:
+            inline void emplace_back(const std::uint32_t a,
+                    const std::uint32_t b) {
+                first_.push_back(a);
+                second_.push_back(b);
+            }
+
+            inline void push_back(const index_pair& p) {
+                emplace_back(p.first, p.second);
+            }
+
+            inline index_pair operator[](const std::size_t i) const {
+                return {first_[i], second_[i]};
+            }
+
+            inline std::span<const std::uint32_t> first() const {
+                return first_;
+            }
+
+            inline std::span<const std::uint32_t> second() const {
+                return second_;
+            }
+
+            inline std::size_t size() const {
+                return first_.size();
+            }
+
+            inline bool empty() const {
+                return first_.empty();
+            }
+
+            inline std::size_t capacity() const {
+                return first_.capacity();
+            }
+
+            inline void reserve(const std::size_t n) {
+                first_.reserve(n);
+                second_.reserve(n);
+            }
+
+            inline void clear() {
+                first_.clear();
+                second_.clear();
+            }
+
+            inline void append(const pair_list& l) {
+                first_.insert(first_.end(), l.first_.begin(), l.first_.end());
+                second_.insert(second_.end(), l.second_.begin(),
+                        l.second_.end());
+            }
+
+            // Keeps the pairs (a, b) for which keep(a, b) holds, in order.
+            template <typename F>
+            inline void retain(F&& keep) {
+                std::size_t n = 0;
+                for (std::size_t i = 0; i < first_.size(); ++i) {
+                    if (keep(first_[i], second_[i])) {
+                        first_[n] = first_[i];
+                        second_[n] = second_[i];
+                        ++n;
+                    }
+                }
+                first_.resize(n);
+                second_.resize(n);
+            }
+
+        private:
+            std::vector<std::uint32_t> first_;
+            std::vector<std::uint32_t> second_;
+        };
+
+        // Broadphase output for one frame: the candidate pairs whose bounds
+        // overlap and those of them the narrowphase confirmed. Meant to be
+        // kept and reused from frame to frame, worker buffers included.
+        class pair_buffer {
+        public:
+            pair_list candidates;
+            pair_list confirmed;
+
+            inline void clear() {
+                candidates.clear();
+                confirmed.clear();
+            }
+
+            // Fills confirmed with the candidates (a, b) for which
+            // narrow(a, b) holds, keeping their order. The candidates are
+            // split into one contiguous range per thread, so narrow must be
+            // safe to call concurrently. threads = 0 uses every hardware
+            // thread.
+            template <typename F>
+            inline void confirm(F&& narrow, const unsigned threads = 0) {
+                const auto n = candidates.size();
+                const auto workers = static_cast<unsigned>(std::min<
+                        std::size_t>(detail::workers(threads),
+                        std::max<std::size_t>(1, n / 1024)));
+                auto& parts = begin_parts(workers);
+                const auto a = candidates.first();
+                const auto b = candidates.second();
+                detail::parallel(workers, [&](const unsigned t) {
+                    const auto lo = n * t / workers;
+                    const auto hi = n * (t + 1) / workers;
+                    auto& out = parts[t];
+                    for (auto i = lo; i < hi; ++i) {
+                        if (narrow(a[i], b[i])) {
+                            out.emplace_back(a[i], b[i]);
+                        }
+                    }
+                });
+                confirmed.clear();
+                gather(confirmed);
+            }
+
+            // Per-worker lists for producers that emit pairs from several
+            // threads: begin_parts(n) clears n of them, gather() appends
+            // them to a list in worker order.
+            inline std::vector<pair_list>& begin_parts(const unsigned n) {
+                if (parts_.size() < n) {
+                    parts_.resize(n);
+                }
+                for (unsigned t = 0; t < n; ++t) {
+                    parts_[t].clear();
+                }
+                active_ = n;
+                return parts_;
+            }
+
+            inline void gather(pair_list& into) const {
+                std::size_t total = into.size();
+                for (unsigned t = 0; t < active_; ++t) {
+                    total += parts_[t].size();
+                }
+                into.reserve(total);
+                for (unsigned t = 0; t < active_; ++t) {
+                    into.append(parts_[t]);
+                }
+            }
+
+        private:
+            std::vector<pair_list> parts_;
+            unsigned active_ = 0;
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_PAIRS_H
@@ -0,0 +1,59 @@
+#ifndef JNF_GEOMETRY_PARALLEL_H
+#define JNF_GEOMETRY_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace jnf {
+    namespace geometry {
+        namespace detail {
+            inline unsigned workers(const unsigned threads) {
+                if (threads != 0) {
+                    return threads;
+                }
+                return std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            // Runs f(worker) on the given number of threads, the calling one
+            // included.
+            template <typename F>
+            inline void parallel(const unsigned threads, F&& f) {
+                std::vector<std::thread> pool;
+                pool.reserve(threads - 1);
+                for (unsigned t = 1; t < threads; ++t) {
+                    pool.emplace_back([&f, t] { f(t); });
+                }
+                f(0u);
+                for (auto& t : pool) {
+                    t.join();
+                }
+            }
+
+            // Calls f(i) for i in [0, n), handing out blocks of indices to
+            // the threads as they become idle.
+            template <typename F>
+            inline void parallel_for(const unsigned threads,
+                    const std::size_t n, const std::size_t block, F&& f) {
+                std::atomic<std::size_t> next{0};
+                parallel(threads, [&](unsigned) {
+                    for (;;) {
+                        const auto b = next.fetch_add(block,
+                                std::memory_order_relaxed);
+                        if (b >= n) {
+                            return;
+                        }
+                        const auto e = std::min(n, b + block);
+                        for (auto i = b; i < e; ++i) {
+                            f(i);
+                        }
+                    }
+                });
+            }
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_PARALLEL_H
@@ -0,0 +1,284 @@
+#ifndef JNF_GEOMETRY_PERF_H
+#define JNF_GEOMETRY_PERF_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counter backend for benchmarking the geometry kernels. On Linux
+// the counters are read through perf_event_open as a single group so that all
+// of them cover exactly the same instructions; elsewhere, or when the kernel
+// refuses an event (perf_event_paranoid, virtual machines), the event is
+// reported as unavailable and only the wall time is measured.
+
+namespace jnf {
+    namespace geometry {
+        namespace perf {
+            enum class event : std::uint8_t {
+                cycles,
+                instructions,
+                branch_misses,
+                l1d_misses,
+                llc_misses,
+                count
+            };
+
+            constexpr std::size_t events =
+                    static_cast<std::size_t>(event::count);
+
+            inline constexpr std::string_view name(const event e) {
+                constexpr std::string_view names[] = {
+                    "cycles", "instructions", "branch-misses", "L1d-misses",
+                    "LLC-misses"
+                };
+                return names[static_cast<std::size_t>(e)];
+            }
+
+            // Keeps the compiler from discarding a kernel whose result is
+            // otherwise unused.
+            template <typename T>
+            inline void keep(const T& v) {
+#if defined(__GNUC__) || defined(__clang__)
+                asm volatile("" : : "r,m"(v) : "memory");
+#else
+                static volatile const void* sink;
+                sink = &v;
+#endif
+            }
+
+            struct reading {
+                std::array<std::uint64_t, events> values{};
+                std::array<bool, events> available{};
+                std::uint64_t nanoseconds = 0;
+            };
+
+            class counters {
+            public:
+                inline counters() {
+#if defined(__linux__)
+                    for (std::size_t i = 0; i < events; ++i) {
+                        open(static_cast<event>(i));
+                    }
+#endif
+                }
+
+                counters(const counters&) = delete;
+
+                counters& operator=(const counters&) = delete;
+
+                inline ~counters() {
+#if defined(__linux__)
+                    for (const auto fd : fds_) {
+                        if (fd >= 0) {
+                            close(fd);
+                        }
+                    }
+#endif
+                }
+
+                inline bool available(const event e) const {
+                    return fds_[static_cast<std::size_t>(e)] >= 0;
+                }
+
+                inline void start() {
+#if defined(__linux__)
+                    if (leader_ >= 0) {
+                        ioctl(leader_, PERF_EVENT_IOC_RESET,
+                                PERF_IOC_FLAG_GROUP);
+                        ioctl(leader_, PERF_EVENT_IOC_ENABLE,
+                                PERF_IOC_FLAG_GROUP);
+                    }
+#endif
+                    start_ = std::chrono::steady_clock::now();
+                }
+
+                inline reading stop() {
+                    const auto end = std::chrono::steady_clock::now();
+                    reading r;
+                    r.nanoseconds = static_cast<std::uint64_t>(
+                            std::chrono::duration_cast<
+                            std::chrono::nanoseconds>(end - start_).count());
+#if defined(__linux__)
+                    if (leader_ < 0) {
+                        return r;
+                    }
+                    ioctl(leader_, PERF_EVENT_IOC_DISABLE,
+                            PERF_IOC_FLAG_GROUP);
+                    // PERF_FORMAT_GROUP layout: nr, time_enabled,
+                    // time_running, then one value per opened event in
+                    // opening order.
+                    std::array<std::uint64_t, 3 + events> buf{};
+                    const auto n = read(leader_, buf.data(),
+                            sizeof(buf));
+                    if (n < static_cast<ssize_t>(3 * sizeof(std::uint64_t))
+                            || buf[2] == 0) {
+                        return r;
+                    }
+                    // Scale for multiplexing when the PMU could not keep the
+                    // whole group scheduled.
+                    const double scale = static_cast<double>(buf[1])
+                            / static_cast<double>(buf[2]);
+                    std::size_t k = 3;
+                    for (std::size_t i = 0; i < events && k < 3 + buf[0];
+                            ++i) {
+                        if (fds_[i] < 0) {
+                            continue;
+                        }
+                        r.values[i] = static_cast<std::uint64_t>(
+                                static_cast<double>(buf[k++]) * scale);
+                        r.available[i] = true;
+                    }
+#endif
+                    return r;
+                }
+
+            private:
+                std::array<int, events> fds_ = {-1, -1, -1, -1, -1};
+                int leader_ = -1;
+                std::chrono::steady_clock::time_point start_;
+
+#if defined(__linux__)
+                inline void open(const event e) {
+                    perf_event_attr a{};
+                    a.size = sizeof(a);
+                    a.disabled = leader_ < 0 ? 1 : 0;
+                    a.exclude_kernel = 1;
+                    a.exclude_hv = 1;
+                    a.read_format = PERF_FORMAT_GROUP
+                            | PERF_FORMAT_TOTAL_TIME_ENABLED
+                            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                    switch (e) {
+                        case event::cycles:
+                            a.type = PERF_TYPE_HARDWARE;
+                            a.config = PERF_COUNT_HW_CPU_CYCLES;
+                            break;
+                        case event::instructions:
+                            a.type = PERF_TYPE_HARDWARE;
+                            a.config = PERF_COUNT_HW_INSTRUCTIONS;
+                            break;
+                        case event::branch_misses:
+                            a.type = PERF_TYPE_HARDWARE;
+                            a.config = PERF_COUNT_HW_BRANCH_MISSES;
+                            break;
+                        case event::l1d_misses:
+                            a.type = PERF_TYPE_HW_CACHE;
+                            a.config = PERF_COUNT_HW_CACHE_L1D
+                                    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                            break;
+                        case event::llc_misses:
+                            a.type = PERF_TYPE_HARDWARE;
+                            a.config = PERF_COUNT_HW_CACHE_MISSES;
+                            break;
+                        default:
+                            return;
+                    }
+                    const int fd = static_cast<int>(syscall(
+                            SYS_perf_event_open, &a, 0, -1, leader_, 0));
+                    if (fd < 0) {
+                        return;
+                    }
+                    fds_[static_cast<std::size_t>(e)] = fd;
+                    if (leader_ < 0) {
+                        leader_ = fd;
+                    }
+                }
+#endif
+            };
+
+            struct result {
+                std::string name;
+                std::uint64_t ops = 0;
+                double ns_per_op = 0;
+                std::array<double, events> per_op{};
+                std::array<bool, events> available{};
+
+                inline double ipc() const {
+                    const auto c = static_cast<std::size_t>(event::cycles);
+                    const auto i =
+                            static_cast<std::size_t>(event::instructions);
+                    if (!available[c] || !available[i] || per_op[c] == 0) {
+                        return 0;
+                    }
+                    return per_op[i] / per_op[c];
+                }
+            };
+
+            // Runs f once as warm-up and then the given number of times under
+            // the counters; f performs ops kernel invocations per call. The
+            // best run is kept, so reported figures are a lower bound.
+            template <typename F>
+            inline result measure(counters& pmu, const std::string_view name,
+                    const std::uint64_t ops, F&& f,
+                    const std::uint32_t runs = 5) {
+                f();
+                result best;
+                best.name = std::string(name);
+                best.ops = ops;
+                for (std::uint32_t run = 0; run < runs; ++run) {
+                    pmu.start();
+                    f();
+                    const auto r = pmu.stop();
+                    const double ns = static_cast<double>(r.nanoseconds)
+                            / static_cast<double>(ops);
+                    if (run != 0 && ns >= best.ns_per_op) {
+                        continue;
+                    }
+                    best.ns_per_op = ns;
+                    for (std::size_t i = 0; i < events; ++i) {
+                        best.available[i] = r.available[i];
+                        best.per_op[i] = static_cast<double>(r.values[i])
+                                / static_cast<double>(ops);
+                    }
+                }
+                return best;
+            }
+
+            // Fixed-width text table, one row per kernel.
+            inline std::string table(const std::vector<result>& results) {
+                std::string s;
+                char buf[64];
+                std::snprintf(buf, sizeof(buf), "%-32s %10s", "kernel",
+                        "ns/op");
+                s += buf;
+                for (std::size_t i = 0; i < events; ++i) {
+                    std::snprintf(buf, sizeof(buf), " %14s",
+                            std::string(name(static_cast<event>(i))).c_str());
+                    s += buf;
+                }
+                s += "        IPC\n";
+                for (const auto& r : results) {
+                    std::snprintf(buf, sizeof(buf), "%-32s %10.3f",
+                            r.name.c_str(), r.ns_per_op);
+                    s += buf;
+                    for (std::size_t i = 0; i < events; ++i) {
+                        if (r.available[i]) {
+                            std::snprintf(buf, sizeof(buf), " %14.3f",
+                                    r.per_op[i]);
+                        } else {
+                            std::snprintf(buf, sizeof(buf), " %14s", "n/a");
+                        }
+                        s += buf;
+                    }
+                    std::snprintf(buf, sizeof(buf), " %10.2f\n", r.ipc());
+                    s += buf;
+                }
+                return s;
+            }
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_PERF_H
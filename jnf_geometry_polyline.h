@@ -0,0 +1,260 @@
+#ifndef JNF_GEOMETRY_POLYLINE_H
+#define JNF_GEOMETRY_POLYLINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_parallel.h"
+
+// Open polylines and their simplification. Both kernels are iterative, so the
+// length of a polyline is bounded by memory rather than by stack depth.
+//
+// Douglas-Peucker keeps every vertex needed to stay within a distance of the
+// original, measured with closest(line, vec2), so a vertex beyond the end of
+// a chord is judged by its distance to the nearer end rather than to the
+// chord's infinite line. Visvalingam-Whyatt drops vertices by increasing
+// effective area, the area of the triangle a vertex forms with its current
+// neighbours, until none of those remaining is below the threshold; it tends
+// to give smoother results at the same vertex count. The first and last
+// vertices are always kept.
+
+namespace jnf {
+    namespace geometry {
+        template <typename T>
+        struct polyline {
+            std::vector<vec2<T>> points;
+
+            inline polyline() = default;
+
+            inline explicit polyline(std::vector<vec2<T>> points)
+                    : points(std::move(points)) {
+            }
+
+            inline std::size_t size() const {
+                return points.size();
+            }
+
+            inline std::size_t segments() const {
+                return points.empty() ? 0 : points.size() - 1;
+            }
+
+            inline line<T> segment(const std::size_t i) const {
+                return line<T>(points[i], points[i + 1]);
+            }
+
+            inline T length() const {
+                T sum = T(0);
+                for (std::size_t i = 0; i < segments(); ++i) {
+                    sum += segment(i).length();
+                }
+                return sum;
+            }
+        };
+
+        template <typename T>
+        inline rect<T> envelope_r(const polyline<T>& l) {
+            if (l.points.empty()) {
+                return rect<T>(vec2<T>(T(0), T(0)), vec2<T>(T(0), T(0)));
+            }
+            auto lo = l.points.front();
+            auto hi = lo;
+            for (const auto& p : l.points) {
+                lo = lo.min(p);
+                hi = hi.max(p);
+            }
+            return rect<T>(lo, hi - lo);
+        }
+
+        namespace detail {
+            template <typename T>
+            struct scalar<polyline<T>> {
+                using type = T;
+            };
+
+            template <typename T>
+            inline T distance2(const line<T>& l, const vec2<T>& p) {
+                return (closest(l, p) - p).mag2();
+            }
+
+            // Effective area of b between a and c: the area of the triangle
+            // they form.
+            template <typename T>
+            inline T effective_area(const vec2<T>& a, const vec2<T>& b,
+                    const vec2<T>& c) {
+                return std::abs((b - a).cross(c - a)) / T(2);
+            }
+
+            inline void keep_points(std::vector<std::uint8_t>& keep,
+                    const std::size_t n) {
+                keep.assign(n, 0);
+                if (n > 0) {
+                    keep.front() = 1;
+                    keep.back() = 1;
+                }
+            }
+
+            template <typename T>
+            inline void gather(const polyline<T>& in,
+                    const std::vector<std::uint8_t>& keep, polyline<T>& out) {
+                out.points.clear();
+                for (std::size_t i = 0; i < in.points.size(); ++i) {
+                    if (keep[i]) {
+                        out.points.push_back(in.points[i]);
+                    }
+                }
+            }
+        }
+
+        // Douglas-Peucker simplification into out, whose storage is reused.
+        // Every dropped vertex lies within tolerance of the simplified
+        // polyline. out must not be in.
+        template <typename T>
+        inline void simplify_dp(const polyline<T>& in, polyline<T>& out,
+                const T tolerance) {
+            const auto n = in.points.size();
+            thread_local std::vector<std::uint8_t> keep;
+            thread_local std::vector<std::pair<std::size_t, std::size_t>> stack;
+            detail::keep_points(keep, n);
+            stack.clear();
+            if (n > 2) {
+                stack.emplace_back(0, n - 1);
+            }
+            const auto t2 = tolerance * tolerance;
+            while (!stack.empty()) {
+                const auto [first, last] = stack.back();
+                stack.pop_back();
+                const line<T> chord(in.points[first], in.points[last]);
+                auto split = first;
+                auto split2 = t2;
+                for (auto i = first + 1; i < last; ++i) {
+                    const auto d2 = detail::distance2(chord, in.points[i]);
+                    if (d2 > split2) {
+                        split2 = d2;
+                        split = i;
+                    }
+                }
+                if (split == first) {
+                    continue;
+                }
+                keep[split] = 1;
+                if (split - first > 1) {
+                    stack.emplace_back(first, split);
+                }
+                if (last - split > 1) {
+                    stack.emplace_back(split, last);
+                }
+            }
+            detail::gather(in, keep, out);
+        }
+
+        template <typename T>
+        inline polyline<T> simplify_dp(const polyline<T>& in,
+                const T tolerance) {
+            polyline<T> out;
+            simplify_dp(in, out, tolerance);
+            return out;
+        }
+
+        // Visvalingam-Whyatt simplification into out, whose storage is
+        // reused: vertices are dropped smallest effective area first while
+        // it is below area. out must not be in.
+        template <typename T>
+        inline void simplify_vw(const polyline<T>& in, polyline<T>& out,
+                const T area) {
+            using entry = std::pair<T, std::uint32_t>;
+            const auto n = in.points.size();
+            thread_local std::vector<std::uint8_t> keep;
+            thread_local std::vector<std::uint32_t> prev;
+            thread_local std::vector<std::uint32_t> next;
+            thread_local std::vector<T> areas;
+            thread_local std::vector<entry> heap;
+            keep.assign(n, 1);
+            if (n <= 2) {
+                detail::gather(in, keep, out);
+                return;
+            }
+            prev.resize(n);
+            next.resize(n);
+            areas.resize(n);
+            heap.clear();
+            const auto& p = in.points;
+            for (std::uint32_t i = 1; i + 1 < n; ++i) {
+                prev[i] = i - 1;
+                next[i] = i + 1;
+                areas[i] = detail::effective_area(p[i - 1], p[i], p[i + 1]);
+                heap.emplace_back(areas[i], i);
+            }
+            // Min-heap with lazy deletion: an entry is stale once the area
+            // of its vertex has changed or the vertex is gone.
+            const std::greater<entry> later;
+            std::make_heap(heap.begin(), heap.end(), later);
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), later);
+                const auto [a, i] = heap.back();
+                heap.pop_back();
+                if (!keep[i] || a != areas[i]) {
+                    continue;
+                }
+                if (!(a < area)) {
+                    break;
+                }
+                keep[i] = 0;
+                const auto l = prev[i];
+                const auto r = next[i];
+                next[l] = r;
+                prev[r] = l;
+                // Neighbours never get a smaller area than the vertex just
+                // removed, so removal order follows the effective areas.
+                for (const auto j : {l, r}) {
+                    if (j == 0 || j == n - 1) {
+                        continue;
+                    }
+                    areas[j] = std::max(a, detail::effective_area(
+                            p[prev[j]], p[j], p[next[j]]));
+                    heap.emplace_back(areas[j], j);
+                    std::push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+            detail::gather(in, keep, out);
+        }
+
+        template <typename T>
+        inline polyline<T> simplify_vw(const polyline<T>& in, const T area) {
+            polyline<T> out;
+            simplify_vw(in, out, area);
+            return out;
+        }
+
+        // Batch forms: out[i] receives the simplification of in[i]. The
+        // polylines are handed out to the threads in blocks; threads = 0 uses
+        // every hardware thread.
+        template <typename T>
+        inline void simplify_dp(const std::span<const polyline<T>> in,
+                const std::span<polyline<T>> out, const T tolerance,
+                const unsigned threads = 0) {
+            detail::parallel_for(detail::workers(threads), in.size(), 64,
+                    [&](const std::size_t i) {
+                simplify_dp(in[i], out[i], tolerance);
+            });
+        }
+
+        template <typename T>
+        inline void simplify_vw(const std::span<const polyline<T>> in,
+                const std::span<polyline<T>> out, const T area,
+                const unsigned threads = 0) {
+            detail::parallel_for(detail::workers(threads), in.size(), 64,
+                    [&](const std::size_t i) {
+                simplify_vw(in[i], out[i], area);
+            });
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_POLYLINE_H
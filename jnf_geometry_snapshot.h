@@ -0,0 +1,226 @@
+#ifndef JNF_GEOMETRY_SNAPSHOT_H
+#define JNF_GEOMETRY_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "jnf_geometry.h"
+#include "jnf_geometry_bvh.h"
+#include "jnf_geometry_mmap.h"
+
+// Snapshots of a built dynamic_bvh. The hierarchy is written as one flat
+// array of nodes in depth-first order, where a node's left child directly
+// follows it and only the index of the right child is stored. Indices are
+// relative to the array, so the file is position independent: bvh_snapshot
+// maps it and queries the nodes in place, without rebuilding or fixing up
+// anything. The depth-first order also keeps every left descent within the
+// same or the next cache line.
+//
+// Snapshots store native byte order and are read back only with the scalar
+// type they were written with.
+
+namespace jnf {
+    namespace geometry {
+        namespace detail {
+            inline constexpr char snapshot_magic[8] = {
+                'J', 'N', 'F', 'S', 'N', 'A', 'P', '\0'
+            };
+
+            constexpr std::uint32_t snapshot_version = 1;
+
+            struct snapshot_header {
+                char magic[8];
+                std::uint32_t version;
+                std::uint32_t scalar;
+                std::uint64_t leaves;
+                std::uint64_t nodes;
+                std::uint64_t offset;
+                std::uint32_t height;
+                std::uint32_t reserved;
+            };
+
+            template <typename T>
+            struct snapshot_node {
+                rect<T> box;
+                std::int32_t right;
+                std::uint32_t id;
+            };
+
+            // Nodes start on a cache line boundary of the mapping.
+            constexpr std::uint64_t snapshot_offset = 64;
+
+            static_assert(sizeof(snapshot_header) <= snapshot_offset);
+        }
+
+        // Writes the tree to path. The file is written under a temporary
+        // name and renamed into place, so readers never map a partial
+        // snapshot. Returns false on I/O errors.
+        template <typename T>
+        inline bool save_snapshot(const dynamic_bvh<T>& tree,
+                const std::string& path) {
+            using node = detail::snapshot_node<T>;
+            constexpr auto null = dynamic_bvh<T>::null;
+            std::vector<node> nodes;
+            nodes.reserve(tree.size() * 2);
+            // Pre-order walk; a right child patches its index into the
+            // parent when it is emitted.
+            struct item {
+                std::int32_t node;
+                std::int32_t parent;
+            };
+            std::vector<item> stack;
+            if (tree.root() != null) {
+                stack.push_back({tree.root(), null});
+            }
+            while (!stack.empty()) {
+                const auto it = stack.back();
+                stack.pop_back();
+                const auto at = static_cast<std::int32_t>(nodes.size());
+                if (it.parent != null) {
+                    nodes[it.parent].right = at;
+                }
+                const auto l = tree.left(it.node);
+                nodes.push_back(node{tree.bounds(it.node), null,
+                        l == null ? tree.id(it.node) : 0u});
+                if (l != null) {
+                    stack.push_back({tree.right(it.node), at});
+                    stack.push_back({l, null});
+                }
+            }
+
+            detail::snapshot_header h{};
+            std::memcpy(h.magic, detail::snapshot_magic, sizeof(h.magic));
+            h.version = detail::snapshot_version;
+            h.scalar = detail::scalar_tag<T>();
+            h.leaves = tree.size();
+            h.nodes = nodes.size();
+            h.offset = detail::snapshot_offset;
+            h.height = static_cast<std::uint32_t>(tree.height());
+
+            const auto tmp = path + ".tmp";
+            std::FILE* f = std::fopen(tmp.c_str(), "wb");
+            if (f == nullptr) {
+                return false;
+            }
+            char head[detail::snapshot_offset] = {};
+            std::memcpy(head, &h, sizeof(h));
+            bool ok = std::fwrite(head, sizeof(head), 1, f) == 1
+                    && (nodes.empty() || std::fwrite(nodes.data(),
+                    sizeof(node), nodes.size(), f) == nodes.size());
+            ok = std::fclose(f) == 0 && ok;
+            if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+                std::remove(tmp.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        // Read-only dynamic_bvh loaded from a snapshot. Queries run directly
+        // on the mapped file; any number of threads may query concurrently.
+        template <typename T>
+        class bvh_snapshot {
+        public:
+            inline bool open(const std::string& path) {
+                file_.close();
+                nodes_ = nullptr;
+                header_ = detail::snapshot_header{};
+                if (!file_.open(path)
+                        || file_.size() < detail::snapshot_offset) {
+                    file_.close();
+                    return false;
+                }
+                std::memcpy(&header_, file_.data(), sizeof(header_));
+                if (std::memcmp(header_.magic, detail::snapshot_magic,
+                        sizeof(header_.magic)) != 0
+                        || header_.version != detail::snapshot_version
+                        || header_.scalar != detail::scalar_tag<T>()
+                        || header_.offset % alignof(node) != 0
+                        || (file_.size() - header_.offset) / sizeof(node)
+                        < header_.nodes) {
+                    file_.close();
+                    header_ = detail::snapshot_header{};
+                    return false;
+                }
+                nodes_ = reinterpret_cast<const node*>(
+                        file_.data() + header_.offset);
+                return true;
+            }
+
+            inline bool is_open() const {
+                return file_.is_open();
+            }
+
+            inline std::size_t size() const {
+                return header_.leaves;
+            }
+
+            inline std::int32_t height() const {
+                return static_cast<std::int32_t>(header_.height);
+            }
+
+            // Calls f(id) for every leaf whose box meets the query box, edges
+            // included, as dynamic_bvh::query does. If f returns bool,
+            // returning false stops the query.
+            template <typename F>
+            inline void query(const rect<T>& box, F&& f) const {
+                if (header_.nodes == 0) {
+                    return;
+                }
+                std::int32_t stack[64];
+                std::vector<std::int32_t> spill;
+                std::size_t top = 0;
+                stack[top++] = 0;
+                while (top > 0 || !spill.empty()) {
+                    std::int32_t i;
+                    if (!spill.empty()) {
+                        i = spill.back();
+                        spill.pop_back();
+                    } else {
+                        i = stack[--top];
+                    }
+                    // Descend along left children, deferring the right ones.
+                    for (;;) {
+                        const auto& n = nodes_[i];
+                        if (!detail::meets(n.box, box)) {
+                            break;
+                        }
+                        if (n.right == dynamic_bvh<T>::null) {
+                            if constexpr (std::is_void_v<std::invoke_result_t<
+                                    F&, std::uint32_t>>) {
+                                f(n.id);
+                            } else if (!f(n.id)) {
+                                return;
+                            }
+                            break;
+                        }
+                        if (top < 64) {
+                            stack[top++] = n.right;
+                        } else {
+                            spill.push_back(n.right);
+                        }
+                        ++i;
+                    }
+                }
+            }
+
+            template <typename S, typename F>
+            inline void query(const S& shape, F&& f) const {
+                query(envelope_r(shape), f);
+            }
+
+        private:
+            using node = detail::snapshot_node<T>;
+
+            mapped_file file_;
+            const node* nodes_ = nullptr;
+            detail::snapshot_header header_{};
+        };
+    }
+}
+
+#endif // JNF_GEOMETRY_SNAPSHOT_H
@@ -0,0 +1,212 @@
+#ifndef JNF_GEOMETRY_TRANSFORM_H
+#define JNF_GEOMETRY_TRANSFORM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+
+#include "jnf_geometry.h"
+
+// 2D transforms and their application to shapes, one at a time or over whole
+// arrays. The batch loops are branch free so that they vectorize like those
+// of jnf_geometry_batch.h.
+//
+// Only vec2 and line map exactly. A rect maps to the envelope_r of its
+// transformed corners. A circle keeps its radius under a rigid transform;
+// under a general affine one its radius is scaled by the largest stretch of
+// the transform, giving the smallest circle around the ellipse with the same
+// center.
+
+namespace jnf {
+    namespace geometry {
+        // Rotation followed by a translation; preserves lengths and angles.
+        template <typename T>
+        struct rigid {
+            T cos = 1;
+            T sin = 0;
+            vec2<T> offset;
+
+            inline explicit rigid(const T angle = T(0),
+                    const vec2<T>& offset = {T(0), T(0)})
+                    : cos(std::cos(angle)), sin(std::sin(angle)),
+                    offset(offset) {
+            }
+
+            inline constexpr vec2<T> apply_vector(const vec2<T>& v) const {
+                return vec2<T>(cos * v.x - sin * v.y, sin * v.x + cos * v.y);
+            }
+
+            inline constexpr vec2<T> operator()(const vec2<T>& p) const {
+                return apply_vector(p) + offset;
+            }
+
+            // This transform applied after r.
+            inline rigid operator*(const rigid& r) const {
+                rigid m;
+                m.cos = cos * r.cos - sin * r.sin;
+                m.sin = sin * r.cos + cos * r.sin;
+                m.offset = (*this)(r.offset);
+                return m;
+            }
+
+            inline rigid inverse() const {
+                rigid m;
+                m.cos = cos;
+                m.sin = -sin;
+                m.offset = -m.apply_vector(offset);
+                return m;
+            }
+        };
+
+        // General affine map p -> x * p.x + y * p.y + offset, x and y being
+        // the images of the unit vectors.
+        template <typename T>
+        struct affine {
+            vec2<T> x{T(1), T(0)};
+            vec2<T> y{T(0), T(1)};
+            vec2<T> offset;
+
+            inline affine() = default;
+
+            inline explicit affine(const vec2<T>& x, const vec2<T>& y,
+                    const vec2<T>& offset = {T(0), T(0)})
+                    : x(x), y(y), offset(offset) {
+            }
+
+            inline explicit affine(const rigid<T>& r)
+                    : x(r.cos, r.sin), y(-r.sin, r.cos), offset(r.offset) {
+            }
+
+            static inline affine translation(const vec2<T>& v) {
+                return affine({T(1), T(0)}, {T(0), T(1)}, v);
+            }
+
+            static inline affine rotation(const T angle) {
+                return affine(rigid<T>(angle));
+            }
+
+            static inline affine scaling(const vec2<T>& s) {
+                return affine({s.x, T(0)}, {T(0), s.y});
+            }
+
+            static inline affine scaling(const T s) {
+                return scaling(vec2<T>(s, s));
+            }
+
+            inline constexpr vec2<T> apply_vector(const vec2<T>& v) const {
+                return x * v.x + y * v.y;
+            }
+
+            inline constexpr vec2<T> operator()(const vec2<T>& p) const {
+                return apply_vector(p) + offset;
+            }
+
+            // This transform applied after a.
+            inline affine operator*(const affine& a) const {
+                return affine(apply_vector(a.x), apply_vector(a.y),
+                        (*this)(a.offset));
+            }
+
+            inline constexpr T det() const {
+                return x.cross(y);
+            }
+
+            // Undefined for a singular transform.
+            inline affine inverse() const {
+                const T r = T(1) / det();
+                const affine m({y.y * r, -x.y * r}, {-y.x * r, x.x * r});
+                return affine(m.x, m.y, -m.apply_vector(offset));
+            }
+
+            // Largest factor by which the transform stretches a vector, the
+            // larger singular value of the linear part.
+            inline T max_scale() const {
+                const T s = (x.mag2() + y.mag2()) / 2;
+                const T d = det();
+                return std::sqrt(s + std::sqrt(std::max(s * s - d * d,
+                        T(0))));
+            }
+        };
+
+        template <typename T>
+        inline vec2<T> transform(const rigid<T>& m, const vec2<T>& p) {
+            return m(p);
+        }
+
+        template <typename T>
+        inline line<T> transform(const rigid<T>& m, const line<T>& l) {
+            return line<T>(m(l.start), m(l.end));
+        }
+
+        template <typename T>
+        inline circle<T> transform(const rigid<T>& m, const circle<T>& c) {
+            return circle<T>(m(c.center), c.radius);
+        }
+
+        template <typename T>
+        inline rect<T> transform(const rigid<T>& m, const rect<T>& r) {
+            const auto h = r.size * T(0.5);
+            const vec2<T> e(std::abs(m.cos) * h.x + std::abs(m.sin) * h.y,
+                    std::abs(m.sin) * h.x + std::abs(m.cos) * h.y);
+            return rect<T>(m(r.pos + h) - e, e * T(2));
+        }
+
+        template <typename T>
+        inline vec2<T> transform(const affine<T>& m, const vec2<T>& p) {
+            return m(p);
+        }
+
+        template <typename T>
+        inline line<T> transform(const affine<T>& m, const line<T>& l) {
+            return line<T>(m(l.start), m(l.end));
+        }
+
+        template <typename T>
+        inline circle<T> transform(const affine<T>& m, const circle<T>& c) {
+            return circle<T>(m(c.center), c.radius * m.max_scale());
+        }
+
+        template <typename T>
+        inline rect<T> transform(const affine<T>& m, const rect<T>& r) {
+            const auto h = r.size * T(0.5);
+            const vec2<T> e(std::abs(m.x.x) * h.x + std::abs(m.y.x) * h.y,
+                    std::abs(m.x.y) * h.x + std::abs(m.y.y) * h.y);
+            return rect<T>(m(r.pos + h) - e, e * T(2));
+        }
+
+        // Batch forms; out must hold in.size() shapes and may be in itself.
+        template <typename M, typename S>
+        inline void transform(const M& m, const std::span<const S> in,
+                const std::span<S> out) {
+            const auto n = in.size();
+            const S* src = in.data();
+            S* dst = out.data();
+            for (std::size_t i = 0; i < n; ++i) {
+                dst[i] = transform(m, src[i]);
+            }
+        }
+
+        // The stretch is computed once rather than per circle.
+        template <typename T>
+        inline void transform(const affine<T>& m,
+                const std::span<const circle<T>> in,
+                const std::span<circle<T>> out) {
+            const auto n = in.size();
+            const auto s = m.max_scale();
+            const circle<T>* src = in.data();
+            circle<T>* dst = out.data();
+            for (std::size_t i = 0; i < n; ++i) {
+                dst[i].center = m(src[i].center);
+                dst[i].radius = src[i].radius * s;
+            }
+        }
+
+        template <typename M, typename S>
+        inline void transform(const M& m, const std::span<S> shapes) {
+            transform(m, std::span<const S>(shapes), shapes);
+        }
+    }
+}
+
+#endif // JNF_GEOMETRY_TRANSFORM_H
@@ -0,0 +1,135 @@
+// Checks that lazy_intersects and first_intersection yield exactly the
+// points of intersects, in the same order, for every supported pair.
+//
+//     g++ -std=c++20 -I.. lazy_intersects.cpp && ./a.out
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// glibc declares a Bessel function jnf in <cmath>, which clashes with the
+// namespace when both are visible.
+#define jnf jnf_
+#include "jnf_geometry.h"
+#include "jnf_geometry_capsule.h"
+#include "jnf_geometry_obb.h"
+
+using namespace jnf;
+using namespace jnf::geometry;
+
+namespace {
+    std::mt19937 rng(1);
+    int failures = 0;
+
+    // Coordinates are often snapped to a coarse grid so that shapes share
+    // edges, corners and tangents.
+    double coord(const double lo, const double hi) {
+        const auto v = std::uniform_real_distribution<double>(lo, hi)(rng);
+        return rng() % 2 ? std::round(v) : v;
+    }
+
+    template <typename S>
+    S shape();
+
+    template <>
+    vec2<double> shape() {
+        return vec2<double>(coord(0, 8), coord(0, 8));
+    }
+
+    template <>
+    line<double> shape() {
+        return line<double>(shape<vec2<double>>(), shape<vec2<double>>());
+    }
+
+    template <>
+    rect<double> shape() {
+        return rect<double>(shape<vec2<double>>(),
+                vec2<double>(coord(0, 5), coord(0, 5)));
+    }
+
+    template <>
+    circle<double> shape() {
+        return circle<double>(shape<vec2<double>>(), coord(0, 4));
+    }
+
+    template <>
+    obb<double> shape() {
+        return obb<double>(shape<vec2<double>>(),
+                vec2<double>(coord(0, 3), coord(0, 3)),
+                rng() % 2 ? 0.0 : coord(0, 6.3));
+    }
+
+    template <>
+    capsule<double> shape() {
+        return capsule<double>(shape<line<double>>(), coord(0, 2));
+    }
+
+    template <typename S1, typename S2>
+    void check(const char* name, const S1& a, const S2& b) {
+        const auto eager = intersects(a, b);
+        std::vector<vec2<double>> lazy;
+        for (const auto& p : lazy_intersects(a, b)) {
+            lazy.push_back(p);
+        }
+        const auto first = first_intersection(a, b);
+        const bool same_first = eager.empty() ? !first
+                : first && *first == eager.front();
+        if (lazy != eager || !same_first) {
+            if (++failures <= 10) {
+                std::printf("%s: %zu points eager, %zu lazy\n", name,
+                        eager.size(), lazy.size());
+            }
+        }
+    }
+
+    template <typename S1, typename S2>
+    void pair(const char* name, const int n = 20000) {
+        for (int i = 0; i < n; ++i) {
+            check(name, shape<S1>(), shape<S2>());
+        }
+    }
+
+    template <typename S>
+    void with_core(const char* a, const char* b, const char* c,
+            const char* d) {
+        pair<S, vec2<double>>(a);
+        pair<S, line<double>>(b);
+        pair<S, rect<double>>(c);
+        pair<S, circle<double>>(d);
+    }
+}
+
+int main() {
+    using V = vec2<double>;
+    check("circle/rect", circle<double>(V(5, 5), 4),
+            rect<double>(V(1.5, 1.5), V(7, 7)));
+    check("rect/rect", rect<double>(V(0, 0), V(4, 4)),
+            rect<double>(V(1, -1), V(2, 6)));
+
+    with_core<vec2<double>>("vec2/vec2", "vec2/line", "vec2/rect",
+            "vec2/circle");
+    with_core<line<double>>("line/vec2", "line/line", "line/rect",
+            "line/circle");
+    with_core<rect<double>>("rect/vec2", "rect/line", "rect/rect",
+            "rect/circle");
+    with_core<circle<double>>("circle/vec2", "circle/line", "circle/rect",
+            "circle/circle");
+    with_core<obb<double>>("obb/vec2", "obb/line", "obb/rect",
+            "obb/circle");
+    with_core<capsule<double>>("capsule/vec2", "capsule/line",
+            "capsule/rect", "capsule/circle");
+    pair<obb<double>, obb<double>>("obb/obb");
+    pair<capsule<double>, capsule<double>>("capsule/capsule");
+    pair<vec2<double>, obb<double>>("vec2/obb");
+    pair<line<double>, obb<double>>("line/obb");
+    pair<rect<double>, obb<double>>("rect/obb");
+    pair<circle<double>, obb<double>>("circle/obb");
+    pair<vec2<double>, capsule<double>>("vec2/capsule");
+    pair<line<double>, capsule<double>>("line/capsule");
+    pair<rect<double>, capsule<double>>("rect/capsule");
+    pair<circle<double>, capsule<double>>("circle/capsule");
+
+    std::printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}